@@ -0,0 +1,65 @@
+/*
+ * beat_stats.c
+ *
+ * How late the beats of a game were dealt with - see beat_stats.h.
+ */
+
+#include "beat_stats.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <avr/pgmspace.h>
+
+// The number of beats that fell in each bucket. Bucket 0 is for beats
+// that were on time, and bucket n for those 2^(n-1) to 2^n - 1 ms late,
+// except for the last bucket which takes everything later. The counts
+// stop at UINT16_MAX rather than wrapping around.
+static uint16_t bucket_count[BEAT_STATS_BUCKETS];
+static uint32_t max_lateness;
+
+void beat_stats_reset(void)
+{
+	for (uint8_t i = 0; i < BEAT_STATS_BUCKETS; i++)
+	{
+		bucket_count[i] = 0;
+	}
+	max_lateness = 0;
+}
+
+void beat_stats_record(uint32_t lateness)
+{
+	uint8_t bucket = 0;
+	uint32_t remaining = lateness;
+	while (remaining != 0 && bucket < BEAT_STATS_BUCKETS - 1)
+	{
+		remaining >>= 1;
+		bucket++;
+	}
+	if (bucket_count[bucket] != UINT16_MAX)
+	{
+		bucket_count[bucket]++;
+	}
+	if (lateness > max_lateness)
+	{
+		max_lateness = lateness;
+	}
+}
+
+void beat_stats_print(void)
+{
+	printf_P(PSTR("Beat lateness (ms): 0:%u"), bucket_count[0]);
+	for (uint8_t i = 1; i < BEAT_STATS_BUCKETS - 1; i++)
+	{
+		uint16_t low = 1 << (i - 1);
+		uint16_t high = (1 << i) - 1;
+		if (low == high)
+		{
+			printf_P(PSTR(" %u:%u"), low, bucket_count[i]);
+		}
+		else
+		{
+			printf_P(PSTR(" %u-%u:%u"), low, high, bucket_count[i]);
+		}
+	}
+	printf_P(PSTR(" %u+:%u max:%lu"), 1 << (BEAT_STATS_BUCKETS - 2),
+			bucket_count[BEAT_STATS_BUCKETS - 1], max_lateness);
+}
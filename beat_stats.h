@@ -0,0 +1,29 @@
+/*
+ * beat_stats.h
+ *
+ * A record of how late each beat of a game was dealt with - the time
+ * between the beat clock counting a beat (see timer0.h) and the notes
+ * being advanced to it. The lateness is kept as a histogram with
+ * power-of-two buckets (0ms, 1ms, 2-3ms, 4-7ms, ... 128-255ms and 256ms
+ * or more), so that it costs a few bytes and no more time however long
+ * the game is, and can be printed over the serial port afterwards.
+ */
+
+#ifndef BEAT_STATS_H_
+#define BEAT_STATS_H_
+
+#include <stdint.h>
+
+#define BEAT_STATS_BUCKETS 10
+
+// Forget the beats recorded so far.
+void beat_stats_reset(void);
+
+// Record that a beat was dealt with the given number of ms late.
+void beat_stats_record(uint32_t lateness);
+
+// Print the histogram, and the most any beat was late, at the cursor on
+// one line.
+void beat_stats_print(void);
+
+#endif /* BEAT_STATS_H_ */
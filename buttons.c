@@ -5,100 +5,168 @@
  */ 
 
 #include "buttons.h"
+#include <stddef.h>
+#include <stdbool.h>
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
-// Global variable to keep track of the last button state so that we 
-// can detect changes when an interrupt fires. The lower 4 bits (0 to 3)
-// will correspond to the last state of port B pins 0 to 3.
-static volatile uint8_t last_button_state;
+// The buttons are sampled every millisecond (from the timer 0 interrupt)
+// and debounced: a button is only taken to have been pushed or released
+// once its pin has read the same for four samples in a row,
+// so contact bounce never produces extra events. The four buttons are
+// debounced together with a vertical counter - bit n of count0 and
+// count1 together count the samples for which button n has differed from
+// its debounced state in button_state (bit n set if pushed), so a few
+// logical operations update all of them at once.
+// change_time[n] and change_beat_time[n] are when the samples of button
+// n last started to differ - when it was pushed or released, give or
+// take any bouncing.
+static uint8_t button_state;
+static uint8_t count0;
+static uint8_t count1;
+static uint32_t change_time[NUM_BUTTONS];
+static BeatTime change_beat_time[NUM_BUTTONS];
 
-// Our button queue. button_queue[0] is always the head of the queue. If we
-// take something off the queue we just move everything else along. We don't
-// use a circular buffer since it is usually expected that the queue is very
-// short. In most uses it will never have more than 1 element at a time.
-// This button queue can be changed by the interrupt handler below so we should
-// turn off interrupts if we're changing the queue outside the handler.
-#define BUTTON_QUEUE_SIZE 4
-static volatile uint8_t button_queue[BUTTON_QUEUE_SIZE];
-static volatile int8_t queue_length;
+// Our button events - a ring buffer written by debounce_buttons()
+// and read by button_event(). Event n is kept in button_events[n %
+// BUTTON_EVENT_QUEUE_SIZE]; events_written counts the events added and
+// events_read the events removed (both wrapping around), so the queue
+// holds events_written - events_read events. Each count is only changed
+// by one side and is a single byte, so neither side has to turn off
+// interrupts. Events which arrive when the queue is full are dropped and
+// counted in events_dropped.
+#define BUTTON_EVENT_QUEUE_SIZE 16	// must be a power of 2
+static volatile ButtonEvent button_events[BUTTON_EVENT_QUEUE_SIZE];
+static volatile uint8_t events_written;
+static volatile uint8_t events_read;
+static volatile uint16_t events_dropped;
 
-// Setup interrupt if any of pins B0 to B3 change. We do this
-// using a pin change interrupt. These pins correspond to pin
-// change interrupts PCINT8 to PCINT11 which are covered by
-// Pin change interrupt 1.
-void init_button_interrupts(void)
+void init_buttons(void)
 {
-	// Enable the interrupt (see datasheet page 77)
-	PCICR |= (1 << PCIE1);
+	// Take the buttons as they are now, so that a button held down
+	// while we start doesn't count as pushed
+	button_state = PINB & 0x0F;
+	count0 = 0;
+	count1 = 0;
 	
-	// Make sure the interrupt flag is cleared (by writing a 
-	// 1 to it) (see datasheet page 78)
-	PCIFR |= (1 << PCIF1);
-	
-	// Choose which pins we're interested in by setting
-	// the relevant bits in the mask register (see datasheet page 78)
-	PCMSK1 |= (1 << PCINT8) | (1 << PCINT9) | (1 << PCINT10) | (1 << PCINT11);	
-	
-	// Empty the button push queue
-	queue_length = 0;
+	// Empty the button event queue
+	events_read = events_written;
+	events_dropped = 0;
 }
 
 int8_t button_pushed(void)
 {
-	int8_t return_value = NO_BUTTON_PUSHED;	// Assume no button pushed
+	return button_pushed_at(NULL);
+}
 
-	if (queue_length > 0)
+int8_t button_pushed_at(BeatTime* time)
+{
+	// Releases are skipped
+	ButtonEvent event;
+	while (button_event(&event))
 	{
-		// Remove the first element off the queue and move all the other
-		// entries closer to the front of the queue. We turn off interrupts (if on)
-		// before we make any changes to the queue. If interrupts were on
-		// we turn them back on when done.
-		return_value = button_queue[0];
-		
-		// Save whether interrupts were enabled and turn them off
-		int8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
-		cli();
-		
-		for (uint8_t i = 1; i < queue_length; i++)
+		if (event.edge == BUTTON_PRESSED)
 		{
-			button_queue[i - 1] = button_queue[i];
-		}
-		queue_length--;
-		
-		if (interrupts_were_enabled)
-		{
-			// Turn them back on again
-			sei();
+			if (time)
+			{
+				*time = event.beat_time;
+			}
+			return event.lane;
 		}
 	}
+	return NO_BUTTON_PUSHED;
+}
+
+bool button_event(ButtonEvent* event)
+{
+	uint8_t read = events_read;
+	if (read == events_written)
+	{
+		return false;
+	}
+	volatile ButtonEvent* next = &button_events[read & (BUTTON_EVENT_QUEUE_SIZE - 1)];
+	event->lane = next->lane;
+	event->edge = next->edge;
+	event->time = next->time;
+	event->beat_time.beats = next->beat_time.beats;
+	event->beat_time.fraction = next->beat_time.fraction;
+	// Only free the entry once it has been copied
+	events_read = read + 1;
+	return true;
+}
+
+uint16_t button_events_dropped(void)
+{
+	uint16_t return_value;
+	
+	// Turn off interrupts (if on) while reading both bytes
+	int8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	return_value = events_dropped;
+	if (interrupts_were_enabled)
+	{
+		sei();
+	}
 	return return_value;
 }
 
-// Interrupt handler for a change on buttons
-ISR(PCINT1_vect)
+void debounce_buttons(void)
 {
-	// Get the current state of the buttons. We'll compare this with
-	// the last state to see what has changed.
-	uint8_t button_state = PINB & 0x0F;
+	uint8_t sample = PINB & 0x0F;
+	uint8_t differs = sample ^ button_state;
 	
-	// Iterate over all the buttons and see which ones have changed.
-	// Any button pushes are added to the queue of button pushes (if
-	// there is space). We ignore button releases so we're just looking
-	// for a transition from 0 in the last_button_state bit to a 1 in the 
-	// button_state.
+	// Note the time at which any button starts to differ (those whose
+	// counts are 0) - reading the time costs too much to do every sample
+	uint8_t starting = differs & ~(count0 | count1);
+	if (starting)
+	{
+		uint32_t now = get_current_time();
+		BeatTime beat_now;
+		get_beat_time(&beat_now);
+		for (uint8_t pin = 0; pin < NUM_BUTTONS; pin++)
+		{
+			if (starting & (1 << pin))
+			{
+				change_time[pin] = now;
+				change_beat_time[pin] = beat_now;
+			}
+		}
+	}
+	
+	// Count on the buttons which differ and reset the others. A count
+	// which wraps around to 0 has reached four - those
+	// buttons have changed state.
+	count1 = (count1 ^ count0) & differs;
+	count0 = ~count0 & differs;
+	uint8_t changed = differs & ~(count0 | count1);
+	if (!changed)
+	{
+		return;
+	}
+	button_state ^= changed;
+	
+	// Add each push or release to the queue of button events, if there is
+	// space.
 	for (uint8_t pin = 0; pin < NUM_BUTTONS; pin++)
 	{
-		if (queue_length < BUTTON_QUEUE_SIZE
-				&& (button_state & (1 << pin))
-				&& !(last_button_state & (1 << pin)))
+		if (changed & (1 << pin))
+		{
+			if ((uint8_t)(events_written - events_read) >= BUTTON_EVENT_QUEUE_SIZE)
+			{
+				if (events_dropped != UINT16_MAX)
 				{
-			// Add the button push to the queue (and update the
-			// length of the queue
-			button_queue[queue_length++] = pin;
+					events_dropped++;
+				}
+				continue;
+			}
+			volatile ButtonEvent* event =
+					&button_events[events_written & (BUTTON_EVENT_QUEUE_SIZE - 1)];
+			event->lane = pin;
+			event->edge = (button_state & (1 << pin)) ? BUTTON_PRESSED : BUTTON_RELEASED;
+			event->time = change_time[pin];
+			event->beat_time.beats = change_beat_time[pin].beats;
+			event->beat_time.fraction = change_beat_time[pin].fraction;
+			events_written++;
 		}
 	}
-	
-	// Remember this button state
-	last_button_state = button_state;
 }
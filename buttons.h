@@ -3,8 +3,8 @@
  *
  * Author: Peter Sutton
  *
- * We assume four push buttons (B0 to B3) are connected to pins B0 to B3. We configure
- * pin change interrupts on these pins.
+ * We assume four push buttons (B0 to B3) are connected to pins B0 to B3. These
+ * pins are sampled every millisecond (see timer0.c) and debounced.
  */ 
 
 
@@ -12,6 +12,8 @@
 #define BUTTONS_H_
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "timer0.h"
 
 #define NO_BUTTON_PUSHED (-1)
 #define BUTTON0_PUSHED 0
@@ -21,18 +23,53 @@
 
 #define NUM_BUTTONS 4
 
-/* Set up pin change interrupts on pins B0 to B3.
+/* Set up the buttons on pins B0 to B3.
  * It is assumed that global interrupts are off when this function is called
  * and are enabled sometime after this function is called.
  */
-void init_button_interrupts(void);
+void init_buttons(void);
 
-/* Return the last button pushed (0 to 3) or -1 (NO_BUTTON_PUSHED) if 
- * there are no button pushes to return. (A small queue of button pushes
- * is kept. This function should be called frequently enough to
- * ensure the queue does not overflow. Excess button pushes are
- * discarded.)
+/* Sample and debounce the buttons, adding any pushes and releases to the
+ * button event queue. Called every millisecond from the timer 0 interrupt
+ * handler. (It takes a bounded time, however much the buttons bounce.)
+ */
+void debounce_buttons(void);
+
+/* A button being pushed or released, as kept in the button event queue.
+ */
+#define BUTTON_PRESSED 1
+#define BUTTON_RELEASED 0
+typedef struct
+{
+	uint8_t lane;	// the button (0 to 3)
+	uint8_t edge;	// BUTTON_PRESSED or BUTTON_RELEASED
+	uint32_t time;	// when it happened (see get_current_time())
+	BeatTime beat_time;	// when it happened by the beat clock
+} ButtonEvent;
+
+/* Take the oldest event off the button event queue and copy it to
+ * *event. Returns false (and leaves *event alone) if the queue is empty.
+ * (The queue holds 16 events. This function should be called frequently
+ * enough to ensure the queue does not overflow. Excess events are
+ * discarded and counted - see button_events_dropped().)
+ */
+bool button_event(ButtonEvent* event);
+
+/* Return the number of button events discarded because the queue was
+ * full, since the buttons were set up.
+ */
+uint16_t button_events_dropped(void);
+
+/* Return the next button pushed (0 to 3) or -1 (NO_BUTTON_PUSHED) if 
+ * there are no button pushes to return, taking button events off the
+ * queue up to and including it. (Releases are skipped.)
  */
 int8_t button_pushed(void);
 
+/* As button_pushed(), but also sets *time (if a button push is returned
+ * and time isn't NULL) to the beat clock time at which the button was
+ * pushed - see timer0.h.
+ */
+int8_t button_pushed_at(BeatTime* time);
+
 #endif /* BUTTONS_H_ */
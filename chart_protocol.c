@@ -0,0 +1,138 @@
+/*
+ * chart_protocol.c
+ *
+ * The chart upload protocol - see chart_protocol.h.
+ */
+
+#include "chart_protocol.h"
+#include <stdint.h>
+
+// Receiver states - the part of the frame expected next
+#define RX_IDLE		0
+#define RX_SEQUENCE	1
+#define RX_LENGTH	2
+#define RX_PAYLOAD	3
+#define RX_CRC_HIGH	4
+#define RX_CRC_LOW	5
+#define RX_DISCARD	6	// after a damaged frame, until the line goes quiet
+
+uint16_t chart_crc16(uint16_t crc, uint8_t byte)
+{
+	crc ^= (uint16_t)byte << 8;
+	for (uint8_t i = 0; i < 8; i++)
+	{
+		if (crc & 0x8000)
+		{
+			crc = (crc << 1) ^ 0x1021;
+		}
+		else
+		{
+			crc <<= 1;
+		}
+	}
+	return crc;
+}
+
+uint8_t chart_build_frame(uint8_t* frame, uint8_t sequence,
+		const uint8_t* payload, uint8_t length)
+{
+	uint8_t n = 0;
+	uint16_t crc = 0;
+	frame[n++] = CHART_SOH;
+	frame[n++] = sequence;
+	crc = chart_crc16(crc, sequence);
+	frame[n++] = length;
+	crc = chart_crc16(crc, length);
+	for (uint8_t i = 0; i < length; i++)
+	{
+		frame[n++] = payload[i];
+		crc = chart_crc16(crc, payload[i]);
+	}
+	frame[n++] = crc >> 8;
+	frame[n++] = crc & 0xFF;
+	return n;
+}
+
+void chart_receiver_reset(ChartReceiver* receiver)
+{
+	receiver->state = RX_IDLE;
+	receiver->next_sequence = 0;
+}
+
+void chart_receiver_resync(ChartReceiver* receiver)
+{
+	receiver->state = RX_IDLE;
+}
+
+uint8_t chart_receiver_in_frame(ChartReceiver* receiver)
+{
+	return receiver->state != RX_IDLE;
+}
+
+uint8_t chart_receiver_feed(ChartReceiver* receiver, uint8_t byte)
+{
+	switch (receiver->state)
+	{
+		case RX_IDLE:
+			// Anything other than the start of a frame is ignored
+			if (byte == CHART_SOH)
+			{
+				receiver->crc = 0;
+				receiver->state = RX_SEQUENCE;
+			}
+			return CHART_RX_BUSY;
+		case RX_SEQUENCE:
+			receiver->sequence = byte;
+			receiver->crc = chart_crc16(receiver->crc, byte);
+			receiver->state = RX_LENGTH;
+			return CHART_RX_BUSY;
+		case RX_LENGTH:
+			if (byte > CHART_MAX_PAYLOAD)
+			{
+				// The rest of the frame can't be found - throw it away
+				receiver->state = RX_DISCARD;
+				return CHART_RX_BUSY;
+			}
+			receiver->length = byte;
+			receiver->received = 0;
+			receiver->crc = chart_crc16(receiver->crc, byte);
+			receiver->state = (byte == 0) ? RX_CRC_HIGH : RX_PAYLOAD;
+			return CHART_RX_BUSY;
+		case RX_PAYLOAD:
+			receiver->payload[receiver->received++] = byte;
+			receiver->crc = chart_crc16(receiver->crc, byte);
+			if (receiver->received == receiver->length)
+			{
+				receiver->state = RX_CRC_HIGH;
+			}
+			return CHART_RX_BUSY;
+		case RX_CRC_HIGH:
+			receiver->crc ^= (uint16_t)byte << 8;
+			receiver->state = RX_CRC_LOW;
+			return CHART_RX_BUSY;
+		case RX_CRC_LOW:
+			receiver->crc ^= byte;
+			if (receiver->crc != 0)
+			{
+				// The length may have been damaged, so more of the frame
+				// may still be coming - it mustn't be taken for the start
+				// of another
+				receiver->state = RX_DISCARD;
+				return CHART_RX_BUSY;
+			}
+			receiver->state = RX_IDLE;
+			if (receiver->sequence == receiver->next_sequence)
+			{
+				receiver->next_sequence++;
+				return (receiver->length == 0) ? CHART_RX_END : CHART_RX_FRAME;
+			}
+			if (receiver->sequence == (uint8_t)(receiver->next_sequence - 1))
+			{
+				return CHART_RX_REPEAT;
+			}
+			return CHART_RX_BAD;
+		default:
+			// Discarding - only chart_receiver_resync() ends this
+			return CHART_RX_BUSY;
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ * chart_protocol.h
+ *
+ * The protocol used to upload a chart to the board over the serial port
+ * (see chart_store.h). Nothing here depends on the AVR, so the same code
+ * is used by the uploader in tools/.
+ *
+ * The computer sends the chart as a series of frames:
+ *   SOH, sequence number, payload length (0 to CHART_MAX_PAYLOAD),
+ *   payload, CRC (high byte first)
+ * The CRC is the CRC-16/XMODEM (polynomial 0x1021, starting from 0) of
+ * the sequence number, length and payload. After each frame the computer
+ * waits for the board to reply ACK (frame stored) or NAK (frame damaged
+ * or out of order - send it again). A damaged frame is only NAKed once
+ * nothing more has arrived for a while (see chart_receiver_resync()), so
+ * that none of it is mistaken for the start of the next frame. A frame
+ * is at most CHART_MAX_FRAME
+ * bytes, which fits in the board's serial input buffer, and nothing more
+ * is sent until the reply - so the board can never be overrun, however
+ * long it takes to store a frame.
+ *
+ * Frame 0 holds the chart header: the chart's length in rows and the
+ * number of bytes of chart data (run-length encoded as in game.c), both
+ * 16 bit, low byte first. Frames 1, 2, 3... (the sequence number wraps
+ * around after 255) hold the chart data, and are never empty. Finally
+ * the computer sends an empty frame with the next sequence number to mark
+ * the end of the chart, and the board replies ACK once the whole chart is
+ * stored. If an ACK is lost the computer sends the frame again - the
+ * board ACKs the repeated frame without storing it again. This includes
+ * the end frame: the board goes on ACKing it for a while after the chart
+ * is stored. The board
+ * replies CAN if it can't take the chart (e.g. it is too big, or the data
+ * doesn't match the header), and the upload is abandoned.
+ */
+
+#ifndef CHART_PROTOCOL_H_
+#define CHART_PROTOCOL_H_
+
+#include <stdint.h>
+
+#define CHART_SOH	0x01
+#define CHART_ACK	0x06
+#define CHART_NAK	0x15
+#define CHART_CAN	0x18
+
+#define CHART_MAX_PAYLOAD	8
+#define CHART_MAX_FRAME		(CHART_MAX_PAYLOAD + 5)
+#define CHART_HEADER_LENGTH	4
+
+// Add a byte to a CRC-16/XMODEM
+uint16_t chart_crc16(uint16_t crc, uint8_t byte);
+
+// Build a frame holding the given payload (at most CHART_MAX_PAYLOAD
+// bytes) in frame[], which must have room for CHART_MAX_FRAME bytes.
+// Returns the number of bytes in the frame.
+uint8_t chart_build_frame(uint8_t* frame, uint8_t sequence,
+		const uint8_t* payload, uint8_t length);
+
+// Receives frames a byte at a time, checking the CRC and the order of
+// the frames.
+typedef struct
+{
+	uint8_t state;
+	uint8_t next_sequence;	// sequence number of the next new frame
+	uint8_t sequence;		// of the frame being received
+	uint8_t length;			// of the frame's payload
+	uint8_t received;		// bytes of the payload received so far
+	uint16_t crc;
+	uint8_t payload[CHART_MAX_PAYLOAD];
+} ChartReceiver;
+
+// Values returned by chart_receiver_feed()
+#define CHART_RX_BUSY	0	// waiting for (more of) a frame
+#define CHART_RX_FRAME	1	// the next frame has arrived - its sequence
+							// number and payload are in the receiver
+#define CHART_RX_REPEAT	2	// the last frame has arrived again (reply ACK)
+#define CHART_RX_BAD	3	// an out of order frame (reply NAK)
+#define CHART_RX_END	4	// the (empty) end frame has arrived
+
+// Get ready to receive frame 0. chart_receiver_resync() instead abandons
+// any partly received or damaged frame but still expects the same next
+// frame - it should be called (and the frame NAKed) after a gap in the
+// bytes arriving while chart_receiver_in_frame().
+void chart_receiver_reset(ChartReceiver* receiver);
+void chart_receiver_resync(ChartReceiver* receiver);
+
+// Returns non-zero if part of a frame has been received (or a damaged
+// frame is being thrown away)
+uint8_t chart_receiver_in_frame(ChartReceiver* receiver);
+
+// Pass the next received byte to the receiver. Returns one of the
+// CHART_RX_ values above.
+uint8_t chart_receiver_feed(ChartReceiver* receiver, uint8_t byte);
+
+#endif /* CHART_PROTOCOL_H_ */
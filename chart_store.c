@@ -0,0 +1,315 @@
+/*
+ * chart_store.c
+ *
+ * Receive a chart over the serial port and keep it in EEPROM - see
+ * chart_store.h.
+ */
+
+#include "chart_store.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "chart_protocol.h"
+#include "serialio.h"
+#include "timer0.h"
+
+// EEPROM layout: a header followed by the chart data. The magic byte is
+// only written once the rest of the chart is, so a chart whose upload
+// was interrupted is never played.
+#define MAGIC_ADDRESS	0	// STORE_MAGIC if a complete chart is stored
+#define LENGTH_ADDRESS	1	// chart length in rows (16 bit)
+#define SIZE_ADDRESS	3	// number of bytes of chart data (16 bit)
+#define DATA_ADDRESS	8
+#define STORE_MAGIC		0xC7
+#define STORE_CAPACITY	(E2END + 1 - DATA_ADDRESS)
+
+// The longest chart the game can play (the beat is 16 bit, and there are
+// 5 beats per row)
+#define MAX_CHART_LENGTH	(UINT16_MAX / 5)
+
+// A partly received or damaged frame is abandoned (and NAKed) once
+// nothing more has arrived for this long (ms)
+#define FRAME_TIMEOUT	200
+
+// Once the chart is stored, a repeated end frame (sent because our ACK
+// was lost) is still ACKed until nothing has arrived for this long (ms).
+// This is longer than chart_upload waits for a reply.
+#define END_TIMEOUT		1500
+
+// Upload states
+#define UPLOAD_IDLE			0
+#define UPLOAD_RECEIVING	1	// waiting for a frame
+#define UPLOAD_WRITING		2	// storing a frame - ACK it when done
+#define UPLOAD_FINISHING	3	// writing the magic byte
+#define UPLOAD_ENDING		4	// stored - ACKing repeats of the end frame
+
+static uint8_t upload_state = UPLOAD_IDLE;
+static ChartReceiver receiver;
+static uint16_t chart_length;	// rows in the chart being received
+static uint16_t chart_size;		// bytes of data in the chart being received
+static uint16_t bytes_received;	// bytes of data received so far
+static uint32_t last_byte_time;
+
+// EEPROM writes still to be made: pending[i] is to be written to
+// pending_address + i
+static uint8_t pending[CHART_MAX_PAYLOAD];
+static uint8_t pending_count;
+static uint8_t pending_written;
+static uint16_t pending_address;
+
+static void reply(uint8_t byte)
+{
+	putchar(byte);
+}
+
+static void queue_writes(uint16_t address, const uint8_t* data, uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++)
+	{
+		pending[i] = data[i];
+	}
+	pending_address = address;
+	pending_count = count;
+	pending_written = 0;
+}
+
+// Start the next waiting EEPROM write, if the EEPROM has finished the
+// last one. Returns non-zero once every write has been started.
+static uint8_t write_pending(void)
+{
+	if (pending_written < pending_count && eeprom_is_ready())
+	{
+		eeprom_update_byte((uint8_t*)(pending_address + pending_written),
+				pending[pending_written]);
+		pending_written++;
+	}
+	return pending_written == pending_count;
+}
+
+static void finish_upload(void)
+{
+	upload_state = UPLOAD_IDLE;
+	serial_set_raw_input(0);
+	clear_serial_input_buffer();
+}
+
+static void fail_upload(void)
+{
+	reply(CHART_CAN);
+	finish_upload();
+}
+
+// Return non-zero if the received chart data decodes to exactly
+// chart_length rows, with no empty runs of empty rows. (Otherwise the
+// game would read past the end of the data.)
+static uint8_t chart_data_valid(void)
+{
+	uint16_t rows = 0;
+	for (uint16_t i = 0; i < chart_size; i++)
+	{
+		if (eeprom_read_byte((const uint8_t*)(DATA_ADDRESS + i)))
+		{
+			rows++;
+		}
+		else
+		{
+			i++;
+			uint8_t run = (i < chart_size)
+					? eeprom_read_byte((const uint8_t*)(DATA_ADDRESS + i)) : 0;
+			if (run == 0)
+			{
+				return 0;
+			}
+			rows += run;
+		}
+		if (rows > chart_length)
+		{
+			return 0;
+		}
+	}
+	return rows == chart_length;
+}
+
+// Deal with a new frame. Frame 0 is the header, the rest are data.
+static void handle_frame(void)
+{
+	if (receiver.sequence == 0 && bytes_received == 0)
+	{
+		if (receiver.length != CHART_HEADER_LENGTH)
+		{
+			fail_upload();
+			return;
+		}
+		chart_length = receiver.payload[0] | (receiver.payload[1] << 8);
+		chart_size = receiver.payload[2] | (receiver.payload[3] << 8);
+		if (chart_size > STORE_CAPACITY || chart_length > MAX_CHART_LENGTH)
+		{
+			fail_upload();
+			return;
+		}
+		// Write the header with the magic byte cleared, so the old chart
+		// is no longer valid.
+		uint8_t header[5] = {0xFF, receiver.payload[0], receiver.payload[1],
+				receiver.payload[2], receiver.payload[3]};
+		queue_writes(MAGIC_ADDRESS, header, sizeof(header));
+	}
+	else
+	{
+		if (bytes_received + receiver.length > chart_size)
+		{
+			fail_upload();
+			return;
+		}
+		queue_writes(DATA_ADDRESS + bytes_received, receiver.payload,
+				receiver.length);
+		bytes_received += receiver.length;
+	}
+	upload_state = UPLOAD_WRITING;
+}
+
+void chart_upload_start(void)
+{
+	chart_receiver_reset(&receiver);
+	chart_size = 0;
+	bytes_received = 0;
+	pending_count = 0;
+	pending_written = 0;
+	serial_set_raw_input(1);
+	clear_serial_input_buffer();
+	(void)serial_input_overrun();
+	last_byte_time = get_current_time();
+	upload_state = UPLOAD_RECEIVING;
+}
+
+uint8_t chart_upload_poll(void)
+{
+	if (upload_state == UPLOAD_WRITING)
+	{
+		if (write_pending())
+		{
+			reply(CHART_ACK);
+			upload_state = UPLOAD_RECEIVING;
+		}
+		return CHART_UPLOAD_BUSY;
+	}
+	if (upload_state == UPLOAD_FINISHING)
+	{
+		if (!write_pending())
+		{
+			return CHART_UPLOAD_BUSY;
+		}
+		reply(CHART_ACK);
+		last_byte_time = get_current_time();
+		upload_state = UPLOAD_ENDING;
+		return CHART_UPLOAD_BUSY;
+	}
+	if (upload_state == UPLOAD_ENDING)
+	{
+		int16_t byte;
+		while ((byte = serial_read_byte()) >= 0)
+		{
+			last_byte_time = get_current_time();
+			if (chart_receiver_feed(&receiver, byte) == CHART_RX_REPEAT)
+			{
+				reply(CHART_ACK);
+			}
+		}
+		if (chart_receiver_in_frame(&receiver)
+				&& get_current_time() - last_byte_time > FRAME_TIMEOUT)
+		{
+			chart_receiver_resync(&receiver);
+			reply(CHART_NAK);
+		}
+		if (get_current_time() - last_byte_time > END_TIMEOUT)
+		{
+			finish_upload();
+			return CHART_UPLOAD_DONE;
+		}
+		return CHART_UPLOAD_BUSY;
+	}
+	if (upload_state != UPLOAD_RECEIVING)
+	{
+		return CHART_UPLOAD_FAILED;
+	}
+	
+	if (serial_input_overrun())
+	{
+		// Part of a frame was lost - ask for it again
+		chart_receiver_resync(&receiver);
+		clear_serial_input_buffer();
+		reply(CHART_NAK);
+	}
+	
+	// Only one frame is dealt with at a time - the computer doesn't send
+	// the next until this one is ACKed
+	int16_t byte;
+	while (upload_state == UPLOAD_RECEIVING
+			&& (byte = serial_read_byte()) >= 0)
+	{
+		last_byte_time = get_current_time();
+		switch (chart_receiver_feed(&receiver, byte))
+		{
+			case CHART_RX_FRAME:
+				handle_frame();
+				break;
+			case CHART_RX_REPEAT:
+				reply(CHART_ACK);
+				break;
+			case CHART_RX_BAD:
+				reply(CHART_NAK);
+				break;
+			case CHART_RX_END:
+				// (The end frame can't be frame 0 - that is the header)
+				if (receiver.sequence == 0 || bytes_received != chart_size
+						|| !chart_data_valid())
+				{
+					fail_upload();
+				}
+				else
+				{
+					uint8_t magic = STORE_MAGIC;
+					queue_writes(MAGIC_ADDRESS, &magic, 1);
+					upload_state = UPLOAD_FINISHING;
+				}
+				break;
+		}
+	}
+	
+	if (upload_state == UPLOAD_RECEIVING && chart_receiver_in_frame(&receiver)
+			&& get_current_time() - last_byte_time > FRAME_TIMEOUT)
+	{
+		// The rest of the frame isn't coming, or it was damaged
+		chart_receiver_resync(&receiver);
+		reply(CHART_NAK);
+	}
+	
+	return (upload_state == UPLOAD_IDLE) ? CHART_UPLOAD_FAILED
+			: CHART_UPLOAD_BUSY;
+}
+
+void chart_upload_cancel(void)
+{
+	finish_upload();
+}
+
+uint8_t chart_store_valid(void)
+{
+	return eeprom_read_byte((const uint8_t*)MAGIC_ADDRESS) == STORE_MAGIC
+			&& eeprom_read_word((const uint16_t*)SIZE_ADDRESS) <= STORE_CAPACITY;
+}
+
+uint16_t chart_store_length(void)
+{
+	return eeprom_read_word((const uint16_t*)LENGTH_ADDRESS);
+}
+
+uint16_t chart_store_size(void)
+{
+	return eeprom_read_word((const uint16_t*)SIZE_ADDRESS);
+}
+
+const uint8_t* chart_store_data(void)
+{
+	return (const uint8_t*)DATA_ADDRESS;
+}
@@ -0,0 +1,50 @@
+/*
+ * chart_store.h
+ *
+ * A chart uploaded from a computer over the serial port (see
+ * chart_protocol.h for the protocol, and tools/chart_upload.c) and kept
+ * in EEPROM, so that it survives a reset and can be played like the
+ * built-in charts.
+ *
+ * An upload runs alongside the rest of the program. chart_upload_start()
+ * switches the serial port to raw input, and chart_upload_poll() - which
+ * must be called regularly, e.g. from the start screen's loop - deals
+ * with whatever has arrived and writes to the EEPROM a byte at a time,
+ * never waiting for a write to finish.
+ */
+
+#ifndef CHART_STORE_H_
+#define CHART_STORE_H_
+
+#include <stdint.h>
+
+// Values returned by chart_upload_poll()
+#define CHART_UPLOAD_BUSY	0
+#define CHART_UPLOAD_DONE	1
+#define CHART_UPLOAD_FAILED	2
+
+// Start receiving a chart. Any chart already stored is replaced once
+// the first frame arrives.
+void chart_upload_start(void);
+
+// Deal with any received bytes and waiting EEPROM writes. Returns
+// CHART_UPLOAD_BUSY until the upload is finished, then CHART_UPLOAD_DONE
+// or CHART_UPLOAD_FAILED. (The serial port is back to normal input after
+// either of those.) CHART_UPLOAD_DONE comes a little after the chart is
+// stored, once the computer has stopped repeating the end frame.
+uint8_t chart_upload_poll(void);
+
+// Abandon an upload
+void chart_upload_cancel(void);
+
+// Returns non-zero if a complete chart is stored in EEPROM
+uint8_t chart_store_valid(void);
+
+// The stored chart's length in rows, the number of bytes of its data and
+// the EEPROM address of its data (run-length encoded as in game.c). Only
+// meaningful if chart_store_valid().
+uint16_t chart_store_length(void);
+uint16_t chart_store_size(void);
+const uint8_t* chart_store_data(void);
+
+#endif /* CHART_STORE_H_ */
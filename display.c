@@ -8,13 +8,23 @@
 #include "display.h"
 #include <stdio.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include "pixel_colour.h"
 #include "ledmatrix.h"
+#include "sprite.h"
 #include "game.h"
 
-// constant value used to display 'AVR HERO' on launch
-static const uint8_t pong_display[MATRIX_NUM_COLUMNS] = 
-		{127, 164, 127, 0, 239, 29, 233, 0, 255, 170, 85, 0, 6, 9, 6, 0};
+// sprite used to display 'AVR HERO' on launch (see sprite.h) - the
+// bottom four rows are red and the top four green
+static const uint8_t pong_display[] PROGMEM = {MATRIX_NUM_COLUMNS, 2,
+		COLOUR_RED, 0x0F, 0x04, 0x0F, 0x00, 0x0F, 0x0D, 0x09, 0x00,
+		0x0F, 0x0A, 0x05, 0x00, 0x06, 0x09, 0x06, 0x00,
+		COLOUR_GREEN, 0x70, 0xA0, 0x70, 0x00, 0xE0, 0x10, 0xE0, 0x00,
+		0xF0, 0xA0, 0x50, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+// Section of the start screen animation tables holding the key frame
+#define START_SCREEN_KEY_FRAME 0
+static void draw_start_screen_section(uint8_t section);
 
 // Fonts for LED Matrix score display
 // Stored as a 5 x 3 grid pattern going from Left-to-Right, Top-to-Bottom
@@ -23,50 +33,137 @@ static const uint8_t pong_display[MATRIX_NUM_COLUMNS] =
 
 void show_start_screen(void)
 {
-	MatrixColumn column_colour_data;
-	uint8_t col_data;
-		
 	ledmatrix_clear(); // start by clearing the LED matrix
-	for (uint8_t col = 0; col < MATRIX_NUM_COLUMNS; col++)
-	{
-		col_data = pong_display[col];
-		// go through the top 7 bits (not the bottom one as that was our colour bit)
-		// and set any to be the correct colour
-		for(uint8_t row = 0; row < MATRIX_NUM_ROWS; row++)
-		{
-			// If the relevant font bit is set, we make this a coloured pixel, else blank
-			if(col_data>>row & 1)
-			{
-				column_colour_data[row] = (row < 4 ? COLOUR_RED : COLOUR_GREEN);
-			}
-			else
-			{
-				column_colour_data[row] = 0;
-			}
-		}
-		ledmatrix_update_column(col, column_colour_data);
-	}
-	update_start_screen(0);
+	sprite_draw(pong_display, 0, 0);
+	draw_start_screen_section(START_SCREEN_KEY_FRAME);
 }
 
 // Update dynamic start screen based on the frame number (0-31)
 // Note: this is hardcoded to PONG game.
-// Purposefully obfuscated so functionality cannot be copied for movement tasks
-void update_start_screen(uint8_t frame_number)
+// The animation is stored as the pixels which change from one frame to
+// the next (generated by tools/gen_start_screen.c), as pairs of bytes:
+// the pixel position ((y << 4) | x, as for the LED matrix pixel command)
+// and its new colour. Section 0 is the key frame drawn by
+// show_start_screen() (the non-black pixels of frame 0); section n + 1
+// holds the changes from frame n - 1 to frame n (frame 31 to frame 0 for
+// n = 0). start_screen_sections[i] is the pair at which section i starts.
+static const uint8_t start_screen_changes[] PROGMEM = {
+	// key frame (frame 0)
+	0x5B, COLOUR_RED, 0x4D, COLOUR_RED, 0x4E, COLOUR_YELLOW, 0x5E, COLOUR_YELLOW,
+	0x6E, COLOUR_YELLOW, 0x7E, COLOUR_YELLOW, 0x7F, COLOUR_GREEN,
+	// frame 0
+	0x5B, COLOUR_RED, 0x4C, COLOUR_BLACK, 0x4D, COLOUR_RED, 0x7E, COLOUR_YELLOW,
+	0x7F, COLOUR_GREEN,
+	// frame 1
+	0x5B, COLOUR_BLACK, 0x5C, COLOUR_RED, 0x4D, COLOUR_BLACK, 0x4E, COLOUR_GREEN,
+	0x7F, COLOUR_BLACK,
+	// frame 2
+	0x4B, COLOUR_RED, 0x5C, COLOUR_BLACK, 0x5D, COLOUR_RED, 0x4E, COLOUR_YELLOW,
+	0x4F, COLOUR_GREEN,
+	// frame 3
+	0x4B, COLOUR_BLACK, 0x4C, COLOUR_RED, 0x5D, COLOUR_BLACK, 0x5E, COLOUR_GREEN,
+	0x4F, COLOUR_BLACK,
+	// frame 4
+	0x6B, COLOUR_RED, 0x4C, COLOUR_BLACK, 0x4D, COLOUR_RED, 0x5E, COLOUR_YELLOW,
+	0x5F, COLOUR_GREEN,
+	// frame 5
+	0x6B, COLOUR_BLACK, 0x6C, COLOUR_RED, 0x4D, COLOUR_BLACK, 0x4E, COLOUR_GREEN,
+	0x5F, COLOUR_BLACK,
+	// frame 6
+	0x4B, COLOUR_RED, 0x6C, COLOUR_BLACK, 0x6D, COLOUR_RED, 0x4E, COLOUR_YELLOW,
+	0x4F, COLOUR_GREEN,
+	// frame 7
+	0x4B, COLOUR_BLACK, 0x4C, COLOUR_RED, 0x6D, COLOUR_BLACK, 0x6E, COLOUR_GREEN,
+	0x4F, COLOUR_BLACK,
+	// frame 8
+	0x5B, COLOUR_RED, 0x4C, COLOUR_BLACK, 0x4D, COLOUR_RED, 0x6E, COLOUR_YELLOW,
+	0x6F, COLOUR_GREEN,
+	// frame 9
+	0x5B, COLOUR_BLACK, 0x5C, COLOUR_RED, 0x4D, COLOUR_BLACK, 0x4E, COLOUR_GREEN,
+	0x6F, COLOUR_BLACK,
+	// frame 10
+	0x4B, COLOUR_RED, 0x5C, COLOUR_BLACK, 0x5D, COLOUR_RED, 0x4E, COLOUR_YELLOW,
+	0x4F, COLOUR_GREEN,
+	// frame 11
+	0x4B, COLOUR_BLACK, 0x4C, COLOUR_RED, 0x5D, COLOUR_BLACK, 0x5E, COLOUR_GREEN,
+	0x4F, COLOUR_BLACK,
+	// frame 12
+	0x4C, COLOUR_BLACK, 0x4D, COLOUR_RED, 0x5E, COLOUR_YELLOW, 0x5F, COLOUR_GREEN,
+	// frame 13
+	0x4D, COLOUR_BLACK, 0x4E, COLOUR_GREEN, 0x5F, COLOUR_BLACK,
+	// frame 14
+	0x4B, COLOUR_RED, 0x4E, COLOUR_YELLOW, 0x4F, COLOUR_GREEN,
+	// frame 15
+	0x4B, COLOUR_BLACK, 0x4C, COLOUR_RED, 0x4F, COLOUR_BLACK,
+	// frame 16
+	0x5B, COLOUR_RED, 0x4C, COLOUR_BLACK, 0x4D, COLOUR_RED,
+	// frame 17
+	0x5B, COLOUR_BLACK, 0x5C, COLOUR_RED, 0x4D, COLOUR_BLACK, 0x4E, COLOUR_GREEN,
+	// frame 18
+	0x4B, COLOUR_RED, 0x5C, COLOUR_BLACK, 0x5D, COLOUR_RED, 0x4E, COLOUR_YELLOW,
+	0x4F, COLOUR_GREEN,
+	// frame 19
+	0x4B, COLOUR_BLACK, 0x4C, COLOUR_RED, 0x5D, COLOUR_BLACK, 0x5E, COLOUR_GREEN,
+	0x4F, COLOUR_BLACK,
+	// frame 20
+	0x6B, COLOUR_RED, 0x4C, COLOUR_BLACK, 0x4D, COLOUR_RED, 0x5E, COLOUR_YELLOW,
+	0x5F, COLOUR_GREEN,
+	// frame 21
+	0x6B, COLOUR_BLACK, 0x6C, COLOUR_RED, 0x4D, COLOUR_BLACK, 0x4E, COLOUR_GREEN,
+	0x5F, COLOUR_BLACK,
+	// frame 22
+	0x4B, COLOUR_RED, 0x6C, COLOUR_BLACK, 0x6D, COLOUR_RED, 0x4E, COLOUR_YELLOW,
+	0x4F, COLOUR_GREEN,
+	// frame 23
+	0x4B, COLOUR_BLACK, 0x4C, COLOUR_RED, 0x6D, COLOUR_BLACK, 0x6E, COLOUR_GREEN,
+	0x4F, COLOUR_BLACK,
+	// frame 24
+	0x5B, COLOUR_RED, 0x4C, COLOUR_BLACK, 0x4D, COLOUR_RED, 0x6E, COLOUR_YELLOW,
+	0x6F, COLOUR_GREEN,
+	// frame 25
+	0x5B, COLOUR_BLACK, 0x5C, COLOUR_RED, 0x4D, COLOUR_BLACK, 0x4E, COLOUR_GREEN,
+	0x6F, COLOUR_BLACK,
+	// frame 26
+	0x4B, COLOUR_RED, 0x5C, COLOUR_BLACK, 0x5D, COLOUR_RED, 0x4E, COLOUR_YELLOW,
+	0x4F, COLOUR_GREEN,
+	// frame 27
+	0x4B, COLOUR_BLACK, 0x4C, COLOUR_RED, 0x5D, COLOUR_BLACK, 0x5E, COLOUR_GREEN,
+	0x4F, COLOUR_BLACK,
+	// frame 28
+	0x7B, COLOUR_RED, 0x4C, COLOUR_BLACK, 0x4D, COLOUR_RED, 0x5E, COLOUR_YELLOW,
+	0x5F, COLOUR_GREEN,
+	// frame 29
+	0x7B, COLOUR_BLACK, 0x7C, COLOUR_RED, 0x4D, COLOUR_BLACK, 0x4E, COLOUR_GREEN,
+	0x5F, COLOUR_BLACK,
+	// frame 30
+	0x4B, COLOUR_RED, 0x7C, COLOUR_BLACK, 0x7D, COLOUR_RED, 0x4E, COLOUR_YELLOW,
+	0x4F, COLOUR_GREEN,
+	// frame 31
+	0x4B, COLOUR_BLACK, 0x4C, COLOUR_RED, 0x7D, COLOUR_BLACK, 0x7E, COLOUR_GREEN,
+	0x4F, COLOUR_BLACK,
+	};
+static const uint8_t start_screen_sections[] PROGMEM = {
+	0, 7, 12, 17, 22, 27, 32, 37, 42, 47, 52, 57,
+	62, 67, 71, 74, 77, 80, 83, 87, 92, 97, 102, 107,
+	112, 117, 122, 127, 132, 137, 142, 147, 152, 157};
+
+// Draw the pixels of the given section of start_screen_changes
+static void draw_start_screen_section(uint8_t section)
 {
-	PixelColour colour;
-	for (uint8_t row = 4; row < 8; row++)
+	uint8_t start = pgm_read_byte(&start_screen_sections[section]);
+	uint8_t end = pgm_read_byte(&start_screen_sections[section + 1]);
+	for (uint8_t i = start; i < end; i++)
 	{
-		for (uint8_t col = 11; col < 16; col++)
-		{
-			colour = col == 14 ? COLOUR_YELLOW : COLOUR_BLACK;
-			if (((32+col-frame_number) & ((1<<(row-2))-1)) == (1<<(row-3))-1)
-			{
-				colour = col < 14 ? COLOUR_RED : COLOUR_GREEN;
-			}
-			ledmatrix_update_pixel(col, row, colour);
-		}
+		uint8_t position = pgm_read_byte(&start_screen_changes[2 * i]);
+		PixelColour colour = pgm_read_byte(&start_screen_changes[2 * i + 1]);
+		ledmatrix_draw_pixel(position & 0x0F, position >> 4, colour);
 	}
+	ledmatrix_flush();
+}
+
+void update_start_screen(uint8_t frame_number)
+{
+	draw_start_screen_section(frame_number % 32 + 1);
 }
 
 // Initialise the display for the board, this creates the display
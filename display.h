@@ -21,7 +21,11 @@ void initialise_display(void);
 // Shows a starting display.
 void show_start_screen(void);
 
-// Update dynamic start screen based on frame number (0-11)
+// Update dynamic start screen to the given frame (0-31). Only the pixels
+// which change from the previous frame are drawn, so the frames must be
+// shown in order: 0 first (straight after show_start_screen()), then 1,
+// 2 ... 31, then 0 again. Skipping or repeating a frame leaves the screen
+// wrong until show_start_screen() is called again.
 void update_start_screen(uint8_t frame_number);
 
 #endif /* DISPLAY_H_ */
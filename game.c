@@ -10,80 +10,191 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stddef.h>
 #include "display.h"
 #include "ledmatrix.h"
 #include "terminalio.h"
 #include <stdbool.h>
+#include <avr/pgmspace.h>
+#include <avr/eeprom.h>
+#include "tracks.h"
+#include "timer0.h"
+#include "status_field.h"
 
-static uint8_t track[TRACK_LENGTH];
+// The chosen track is read as a list of note events, one for each row of
+// the track which isn't empty, in order. Most rows are empty, so the game
+// only has to look at the few events which are on the highway rather
+// than at every column. Events are numbered from 0 at the start of the
+// track. The track itself stays in flash - only the events from the one
+// leaving the highway to the ghost note are held, in a small ring
+// (window[n % EVENT_WINDOW_SIZE] holds event n), and more are read as
+// they are needed (see get_event()), so a track can be any length.
+typedef struct
+{
+	uint16_t row;	// index of the row in the track
+	uint8_t lanes;	// the track byte - bit n is set for a note in lane n,
+					// and bit n+4 if the note before it in lane n is held
+					// on through this row (see TAIL())
+	uint8_t hit;	// bit n is set once the note in lane n has been played
+} NoteEvent;
 
-static const uint8_t custom_track[TRACK_LENGTH] = {0x00,
-	0x00, 0x00, 0x08, 0x08, 0x08, 0x80, 0x04, 0x02,
-	0x04, 0x40, 0x08, 0x80, 0x00, 0x00, 0x04, 0x02,
-	0x04, 0x40, 0x08, 0x04, 0x40, 0x02, 0x20, 0x01,
-	0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x02, 0x20,
-	0x04, 0x40, 0x08, 0x80, 0x04, 0x40, 0x02, 0x20,
-	0x04, 0x40, 0x08, 0x04, 0x40, 0x40, 0x02, 0x20,
-	0x04, 0x40, 0x08, 0x04, 0x40, 0x02, 0x20, 0x01,
-	0x10, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00,
-	0x00, 0x00, 0x08, 0x08, 0x08, 0x80, 0x04, 0x02,
-	0x04, 0x40, 0x02, 0x08, 0x80, 0x00, 0x02, 0x01,
-	0x04, 0x40, 0x08, 0x80, 0x04, 0x02, 0x20, 0x01,
-	0x10, 0x10, 0x12, 0x20, 0x00, 0x00, 0x02, 0x20,
-	0x04, 0x40, 0x08, 0x04, 0x40, 0x40, 0x02, 0x20,
-	0x04, 0x40, 0x08, 0x04, 0x40, 0x40, 0x02, 0x20,
-	0x04, 0x40, 0x08, 0x04, 0x40, 0x40, 0x02, 0x20,
-	0x01, 0x10, 0x10, 0x10, 0x00, 0x00, 0x00, 0x00};
-	
-static const uint8_t twinkle_twinkle_little_star[TRACK_LENGTH] = {0x00, 0x00, 0x00,// (pause)
-	0x02, 0x02, 0x04, 0x04, 0x08, 0x08, 0x04, 0x00, // Twinkle, twinkle,
-	0x04, 0x04, 0x02, 0x02, 0x01, 0x01, 0x08, 0x00, // little star,
-	0x08, 0x08, 0x04, 0x04, 0x02, 0x02, 0x01, 0x00, // How I wonder
-	0x02, 0x02, 0x04, 0x04, 0x08, 0x08, 0x04, 0x00, // what you are!
-	0x04, 0x04, 0x02, 0x02, 0x01, 0x01, 0x08, 0x00, // Twinkle, twinkle,
-	0x04, 0x04, 0x02, 0x02, 0x01, 0x01, 0x08, 0x00, // little star,
-	0x08, 0x08, 0x04, 0x04, 0x02, 0x02, 0x01, 0x00, // How I wonder
-	0x02, 0x02, 0x04, 0x04, 0x08, 0x08, 0x04, 0x00, // what you are!
-	0x00, 0x00, 0x08, 0x08, 0x04, 0x04, 0x02, 0x00, // Up above the
-	0x02, 0x02, 0x01, 0x01, 0x08, 0x08, 0x04, 0x00, // world so high,
-	0x01, 0x01, 0x02, 0x02, 0x04, 0x04, 0x02, 0x00, // like a diamond
-	0x00, 0x00, 0x08, 0x08, 0x04, 0x04, 0x02, 0x00, // Up above the
-	0x02, 0x02, 0x01, 0x01, 0x08, 0x08, 0x04, 0x00, // world so high,
-	0x01, 0x01, 0x02, 0x02, 0x04, 0x04, 0x02, 0x00, // like a diamond
-	0x02, 0x02, 0x04, 0x04, 0x08, 0x08, 0x04, 0x00, // Twinkle, twinkle,
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00 // little star,
-	};
+#define EVENT_WINDOW_SIZE 16	// must be a power of 2
 
-static const uint8_t jingle_bells[TRACK_LENGTH] = {0x00,0x00, // (pause)
-	0x00, // (pause)
-	0x08, 0x08, 0x08, 0x00, // G G G (pause)
-	0x08, 0x08, 0x08, 0x00, // G G G (pause)
-	0x08, 0x04, 0x02, 0x02, 0x02, 0x08, 0x04, // G F E E E G F (pause) D
-	0x01, 0x01, 0x01, 0x02, 0x02, 0x08, 0x04, 0x00, // D D D E E G F (pause) D
-	0x08, 0x00, // G (pause)
-	0x08, 0x04, 0x02, 0x02, 0x02, 0x00, // G F E E E (pause)
-	0x08, 0x08, 0x08, 0x00, // G G G (pause)
-	0x08, 0x08, 0x08, 0x04, // G G G F
-	0x01, 0x02, 0x02, 0x02, 0x08, 0x04, // D E E E G F
-	0x01, 0x01, 0x02, 0x02, 0x02, 0x04, 0x04, 0x02, // D D E E E F F G
-	0x02, 0x02, 0x02, 0x02, 0x01, 0x01, 0x02, 0x02, // E E E E D D E E
-	0x08, 0x08, 0x02, 0x02, 0x02, 0x02, 0x02, 0x01, // G G A A A A B D
-	0x02, 0x02, 0x02, 0x00, // E E E (pause)
+static const uint8_t* track;	// the next byte of the chosen track
+static const uint8_t* track_end;	// just past its last byte
+static bool track_in_eeprom;	// whether it is in EEPROM (else flash)
+static uint16_t track_length;	// number of rows in the chosen track
+static uint16_t next_row;	// the next row of the track to be read
+static NoteEvent window[EVENT_WINDOW_SIZE];
+static uint16_t num_events;	// number of events read so far
 
-	0x02, 0x02, 0x02, 0x00, // F F F (pause)
-	0x02, 0x02, 0x02, 0x00, // E E E (pause)
-	0x08, 0x04, 0x02, 0x02, 0x02, 0x08, 0x04, // G F E E E G F (pause) D
-	0x01, 0x01, 0x01, 0x02, 0x02, 0x08, 0x04, 0x00, // D D D E E G F (pause) D
-	0x08, 0x00, // G (pause)
-	0x08, 0x04, 0x02, 0x02, 0x02, 0x00, // G F E E E (pause)
-	0x08, 0x08, 0x08, 0x00, // G G G (pause)
-	0x08, 0x08, 0x08, 0x04, // G G G F
-	0x01, 0x02, 0x02, 0x02, 0x08, 0x04, // D E E E G F
+// Returned for events past the end of the track. It has no notes, so is
+// never changed.
+static NoteEvent end_of_track = {UINT16_MAX, 0, 0};
 
-	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // (pause)
-	};
-	
-static bool green_note;
+// Number of the first event which hasn't left the highway, i.e. the first
+// whose row is at or to the left of the last column (5*row >= beat).
+static uint16_t first_event;
+
+// Index of the event shown as the ghost note in the first column: the
+// first event with a note whose row is after the row just off the left of
+// the highway. It only ever moves forward, so finding the ghost note
+// costs nothing per beat no matter how long the gap before it. (The notes
+// after it are simply the following events.)
+static uint16_t ghost_event;
+
+// The scoring area is the columns from SCORING_AREA_START to the last.
+// A note can be played while it is there, and is judged by how far the
+// time it was played is from its arrival time - halfway through its time
+// in the middle column of the scoring area - which doesn't depend on how
+// often the game loop looks at the buttons.
+#define SCORING_AREA_START	11
+#define ARRIVAL_COLUMN		13
+
+// How a note is scored, by how far from its arrival time it was played.
+// The distance is rounded up to a whole number of JUDGEMENT_STEP_MS and
+// looked up in judgements[], so a hit is scored without any decisions
+// and the windows can be changed by changing the table. A note further
+// than the last entry from its arrival time can't be played. (At normal
+// speed a note spends 200ms in each column, so the windows match the
+// columns of the scoring area: PERFECT in the middle column, GREAT in the
+// columns either side of it and GOOD in the outer columns.)
+typedef struct
+{
+	uint8_t judgement;	// PERFECT, GREAT or GOOD (see game.h)
+	uint8_t points;	// added to the score
+	uint8_t combo_points;	// added to the score instead if the combo is over 3
+	uint8_t combo_step;	// added to the combo
+	uint8_t early_dutycycle;	// % - of the note's sound if played early
+	uint8_t late_dutycycle;	// % - of the note's sound if played late
+} Judgement;
+
+#define JUDGEMENT_STEP_MS	50
+#define NUM_JUDGEMENTS		11
+#define JUDGEMENT_LIMIT_MS	(JUDGEMENT_STEP_MS * (NUM_JUDGEMENTS - 1))
+static const Judgement judgements[NUM_JUDGEMENTS] PROGMEM = {
+	{PERFECT,	3, 4, 1, 50, 50},	// 0ms
+	{PERFECT,	3, 4, 1, 50, 50},	// up to 50ms
+	{PERFECT,	3, 4, 1, 50, 50},	// up to 100ms
+	{GREAT,		2, 2, 0, 10, 90},	// up to 150ms
+	{GREAT,		2, 2, 0, 10, 90},	// up to 200ms
+	{GREAT,		2, 2, 0, 10, 90},	// up to 250ms
+	{GREAT,		2, 2, 0, 10, 90},	// up to 300ms
+	{GOOD,		1, 1, 0, 2, 98},	// up to 350ms
+	{GOOD,		1, 1, 0, 2, 98},	// up to 400ms
+	{GOOD,		1, 1, 0, 2, 98},	// up to 450ms
+	{GOOD,		1, 1, 0, 2, 98}		// up to 500ms
+};
+
+// Hold notes. A note whose lane has its tail bit - TAIL(lane) - set in
+// the rows after it is held on through those rows, and is drawn with a
+// trail reaching them. If the note is played, its lane's bit is set in
+// holding until the button is released or the trail has gone past, and
+// a point is scored for each beat that the trail goes past the end of the
+// highway while it is held. trailing has the bits of the lanes whose
+// trail is going past the end. Only the row leaving the highway is looked
+// at, once a row, so holding costs the same however many notes are held
+// or however long they are.
+#define TAIL(lane) (0x10 << (lane))
+static uint8_t holding;
+static uint8_t trailing;
+
+// The number of notes given each judgement (indexed by PERFECT, GREAT or
+// GOOD) this game
+static uint16_t judgement_counts[NUM_JUDGEMENT_CLASSES];
+
+// The score and combo shown on the terminal
+static const char score_label[] PROGMEM = "\x1b[14;10HGame Score: ";
+static const char score_row[] PROGMEM = "\x1b[14;";
+static StatusField score_field = {score_label, score_row, 22, 5, {0}};
+static const char combo_label[] PROGMEM = "\x1b[22;10HCOMBO SCORE: ";
+static const char combo_row[] PROGMEM = "\x1b[22;";
+static StatusField combo_field = {combo_label, combo_row, 23, 3, {0}};
+
+// Whether the highway has been drawn since the game started, and
+// whether its notes were drawn orange (combo) or red. The highway is
+// scrolled with the matrix's shift command, so a full redraw is only
+// needed at the start or when the note colour changes.
+static bool highway_drawn;
+static bool highway_orange;
+
+// Read the next byte of the chosen track (0 past the end of it)
+static uint8_t read_track(void)
+{
+	if (track == track_end)
+	{
+		return 0;
+	}
+	if (track_in_eeprom)
+	{
+		return eeprom_read_byte(track++);
+	}
+	return pgm_read_byte(track++);
+}
+
+// Return event number i, reading more of the track into the window if
+// need be. Past the end of the track (or further ahead than the window
+// can hold) an event whose row is past the end of the track is returned.
+static NoteEvent* get_event(uint16_t i)
+{
+	while (i >= num_events)
+	{
+		if (next_row >= track_length || track == track_end
+				|| num_events - first_event >= EVENT_WINDOW_SIZE)
+		{
+			return &end_of_track;
+		}
+		uint8_t lanes = read_track();
+		if (lanes)
+		{
+			NoteEvent* event = &window[num_events & (EVENT_WINDOW_SIZE - 1)];
+			event->row = next_row;
+			event->lanes = lanes;
+			event->hit = 0;
+			num_events++;
+			next_row++;
+		}
+		else
+		{
+			// skip a run of empty rows
+			next_row += read_track();
+		}
+	}
+	return &window[i & (EVENT_WINDOW_SIZE - 1)];
+}
+
+// Move ghost_event on past the rows which have reached the highway
+static void update_ghost_event(void)
+{
+	uint16_t row = (MATRIX_NUM_COLUMNS+beat)/5;
+	const NoteEvent* event = get_event(ghost_event);
+	while (event->row < track_length
+			&& (event->row <= row || !(event->lanes & 0x0F)))
+	{
+		ghost_event++;
+		event = get_event(ghost_event);
+	}
+}
 
 // Initialise the game by resetting the grid and beat
 void initialise_game(void)
@@ -94,349 +205,411 @@ void initialise_game(void)
 	game_score = 0;
 	combo_score = 0;
 	turn_off_audio = false;
+	holding = 0;
+	trailing = 0;
+	for (uint8_t i = 0; i < NUM_JUDGEMENT_CLASSES; i++)
+	{
+		judgement_counts[i] = 0;
+	}
+	highway_drawn = false;
+	ledmatrix_reset_flush_stats();
 	
-	if (track_choice == 0)
+	Track chosen;
+	track_get(track_choice, &chosen);
+	track = chosen.data;
+	track_end = chosen.data + chosen.size;
+	track_length = chosen.length;
+	track_in_eeprom = (chosen.source == TRACK_IN_EEPROM);
+	next_row = 0;
+	num_events = 0;
+	first_event = 0;
+	ghost_event = 0;
+	update_ghost_event();
+}
+
+// Return the event for the given row of the track, or end_of_track (which
+// has no notes) if the row is empty. The row must be on the highway or
+// still to come.
+static const NoteEvent* event_in_row(uint16_t row)
+{
+	uint16_t i = first_event;
+	while (get_event(i)->row < row)
 	{
-		for (int i = 0; i < TRACK_LENGTH; i++)
-		{
-			track[i] = custom_track[i];
-		}
+		i++;
 	}
-	else if (track_choice == 1)
+	return (get_event(i)->row == row) ? get_event(i) : &end_of_track;
+}
+
+// Return how long after the given row's arrival time (see SCORING_AREA_START)
+// the given time is, in microseconds - negative if it is before.
+static int32_t arrival_offset(uint16_t row, const BeatTime* time)
+{
+	// The row is drawn in ARRIVAL_COLUMN from this beat until the next,
+	// and arrives halfway between them
+	uint16_t arrival = 5*row - (MATRIX_NUM_COLUMNS-1-ARRIVAL_COLUMN);
+	int16_t beats = time->beats - arrival;
+	// Far enough away to be outside every window, and to not overflow
+	if (beats > 16)
 	{
-		for (int i = 0; i < TRACK_LENGTH; i++)
-		{
-			track[i] = twinkle_twinkle_little_star[i];
-		}
+		beats = 16;
 	}
-	else if (track_choice == 2)
+	else if (beats < -16)
 	{
-		for (int i = 0; i < TRACK_LENGTH; i++)
-		{
-			track[i] = jingle_bells[i];
-		}
+		beats = -16;
 	}
+	return beat_fractions_to_us(beats * BEAT_FRACTIONS + time->fraction
+			- BEAT_FRACTIONS/2);
 }
 
-// Play a note in the given lane
-void play_note(uint8_t lane)
+// Play a note in the given lane, pushed at the given time
+void play_note(uint8_t lane, const BeatTime* time, bool can_hold)
 {
 	note_played = 0;
-	uint8_t missednote = true;
-	// YOUR CODE HERE
-	// possible steps:
-	// a) check if there is a note in the scoring area of the given lane -
-	//    look at advance_note below for a hint to the logic
-	// b) if there is, immediately turn those notes green
-	// c) set up a variable to remember if notes should be green,
-	//    and trigger it simultaneously with b)
-	// d) in advance_note below, poll that variable, and choose COLOUR_GREEN
-	//    instead of COLOUR_RED for ledmatrix_update_pixel if required
-	// e) depending on your implementation, clear the variable in
-	//    advance_note when a note disappears from the screen
 	
-	for (uint8_t col=0; col<MATRIX_NUM_COLUMNS; col++)
+	// audio freq
+	if (lane == 0)
+	{
+		freq = 523.2511;
+	}
+	else if (lane == 1)
+	{
+		freq = 622.254;
+	}
+	else if (lane == 2)
+	{
+		freq = 698.4565;
+	}
+	else if (lane == 3)
 	{
-		// col counts from one end, future from the other
-		uint8_t future = MATRIX_NUM_COLUMNS-1-col;
-		// notes are only drawn every five columns
-		if ((future+beat)%5)
+		freq = 783.9909;
+	}
+	
+	// Find the note in this lane in the scoring area which was played
+	// nearest to its arrival time, if any is near enough to be played.
+	NoteEvent* closest = NULL;
+	int32_t closest_offset = 0;
+	bool already_hit = false;
+	bool out_of_window = false;
+	for (uint16_t i = first_event; get_event(i)->row < track_length; i++)
+	{
+		NoteEvent* event = get_event(i);
+		// future counts from the last column, col from the first
+		uint16_t future = 5*event->row - beat;
+		if (future >= MATRIX_NUM_COLUMNS - SCORING_AREA_START)
+		{
+			// this and every later event hasn't reached the scoring area
+			break;
+		}
+		if (!(event->lanes & (1<<lane)))
 		{
 			continue;
 		}
-		
-		// index of which note in the track to play
-		uint8_t index = (future+beat)/5;
-		// if the index is beyond the end of the track,
-		// no note can be drawn
-		if (index >= TRACK_LENGTH)
+		if (event->hit & (1<<lane))
 		{
+			already_hit = true;
 			continue;
 		}
+		int32_t offset = arrival_offset(event->row, time);
+		if (labs(offset) > JUDGEMENT_LIMIT_MS * 1000L)
+		{
+			out_of_window = true;
+		}
+		else if (!closest || labs(offset) < labs(closest_offset))
+		{
+			closest = event;
+			closest_offset = offset;
+		}
+	}
+	
+	if (closest)
+	{
+		closest->hit |= (1<<lane);
+		note_played = 1;
+		beat_count = beat;
+		
+		Judgement judgement;
+		uint16_t distance = (labs(closest_offset) + JUDGEMENT_STEP_MS*1000L - 1)
+				/ (JUDGEMENT_STEP_MS*1000L);
+		memcpy_P(&judgement, &judgements[distance], sizeof(Judgement));
+		
+		//audio duty cycle - lower if early, higher if late
+		dutycycle = (closest_offset < 0) ? judgement.early_dutycycle
+				: judgement.late_dutycycle;
+		combo_score += judgement.combo_step;
+		game_score += (combo_score > 3) ? judgement.combo_points : judgement.points;
+		judgement_counts[judgement.judgement]++;
 		
-		// check if there's a note in the specific path
-		if (track[index] & (1<<lane))
+		uint8_t col = MATRIX_NUM_COLUMNS-1-(5*closest->row - beat);
+		ledmatrix_draw_pixel(col, 2*lane, COLOUR_GREEN);
+		ledmatrix_draw_pixel(col, 2*lane+1, COLOUR_GREEN);
+		
+		// if it is a hold note, it is now being held
+		if (can_hold && (event_in_row(closest->row + 1)->lanes & TAIL(lane)))
 		{
-			// audio freq
-			if (lane == 0)
-			{
-				freq = 523.2511;
-			}
-			else if (lane == 1)
-			{
-				freq = 622.254;
-			}
-			else if (lane == 2)
-			{
-				freq = 698.4565;
-			}
-			else if (lane == 3)
-			{
-				freq = 783.9909;
-			}
-			
-			if (col >= 11)
-			{
-				missednote = false;
-			}
-			
-			if (green_note && col >= 11)
-			{
-				// turning OFF audio
-				turn_off_audio = true;
-				
-				game_score--;
-				print_game_score(game_score);
-				
-				//Printing combo score
-				move_terminal_cursor(10, 22);
-				printf("COMBO SCORE: %2d", combo_score);
-			}
-			else if (col == 11 || col == 15)
-			{
-				note_played = 1;
-				beat_count = beat;
-				
-				//audio duty cycle
-				if (col == 11)
-				{
-					dutycycle = 2;
-				}
-				else if (col == 15)
-				{
-					dutycycle = 98;
-				}
-				
-				green_note = true;
-				game_score++;
-				print_game_score(game_score);
-				
-				//Printing combo score
-				move_terminal_cursor(10, 22);
-				printf("COMBO SCORE: %2d", combo_score);
-				
-				ledmatrix_update_pixel(col, 2*lane, COLOUR_GREEN);
-				ledmatrix_update_pixel(col, 2*lane+1, COLOUR_GREEN);
-			}
-			else if (col == 12 || col == 14)
-			{
-				note_played = 1;
-				beat_count = beat;
-				
-				//audio duty cycle
-				if (col == 12)
-				{
-					dutycycle = 10;
-				}
-				else if (col == 14)
-				{
-					dutycycle = 90;
-				}
-				
-				green_note = true;
-				game_score += 2;
-				print_game_score(game_score);
-				
-				//Printing combo score
-				move_terminal_cursor(10, 22);
-				printf("COMBO SCORE: %2d", combo_score);
-				
-				ledmatrix_update_pixel(col, 2*lane, COLOUR_GREEN);
-				ledmatrix_update_pixel(col, 2*lane+1, COLOUR_GREEN);
-			}
-			else if (col == 13)
-			{
-				note_played = 1;
-				beat_count = beat;
-				
-				//audio duty cycle
-				dutycycle = 50;
-				
-				combo_score++;
-				green_note = true;
-				if (combo_score > 3)
-				{
-					game_score += 4;
-				}
-				else
-				{
-					game_score += 3;
-				}
-				print_game_score(game_score);
-				
-				//Printing combo score
-				move_terminal_cursor(10, 22);
-				printf("COMBO SCORE: %2d", combo_score);
-
-				ledmatrix_update_pixel(col, 2*lane, COLOUR_GREEN);
-				ledmatrix_update_pixel(col, 2*lane+1, COLOUR_GREEN);
-			}
+			holding |= (1<<lane);
 		}
 	}
-	if (missednote)
+	else if (already_hit)
 	{
+		// the note here has been played already
 		// turning OFF audio
 		turn_off_audio = true;
 		
-		combo_score = 0;
 		game_score--;
-		print_game_score(game_score);
+	}
+	else if (out_of_window)
+	{
+		// there is a note here, but it was played just before it reached
+		// the scoring area or just after it left (the push is timed from
+		// before it was seen) - not a mistake
+		// turning OFF audio
+		turn_off_audio = true;
+	}
+	else
+	{
+		// no note here to play
+		// turning OFF audio
+		turn_off_audio = true;
 		
-		//Printing combo score
-		move_terminal_cursor(10, 22);
-		printf("COMBO SCORE: %2d", combo_score);
+		combo_score = 0;
+		game_score--;
 	}
+	print_game_score(game_score);
+	print_combo_score();
 }
 
-// Advance the notes one row down the display
-void advance_note(void)
+uint16_t judgement_count(uint8_t judgement)
+{
+	return judgement_counts[judgement];
+}
+
+// Release the button for the given lane, ending any hold note being held
+void release_note(uint8_t lane)
 {
-	// remove all the current notes; reverse of below
-	for (uint8_t col=0; col<MATRIX_NUM_COLUMNS; col++)
+	if (holding & (1<<lane))
 	{
-		uint8_t future = MATRIX_NUM_COLUMNS - 1 - col;
-		uint8_t index = (future + beat) / 5;
-		if (index >= TRACK_LENGTH)
+		holding &= ~(1<<lane);
+		if (!holding)
 		{
-			break;
+			// turning OFF audio
+			turn_off_audio = true;
 		}
-		if ((future+beat) % 5)
+	}
+}
+
+// Colour of the empty highway in the given column - yellows in the
+// scoring area, black elsewhere
+static PixelColour background_colour(uint8_t col)
+{
+	if (col == 11 || col == 15)
+	{
+		return COLOUR_QUART_YELLOW;
+	}
+	else if (col == 12 || col == 14)
+	{
+		return COLOUR_HALF_YELLOW;
+	}
+	else if (col == 13)
+	{
+		return COLOUR_YELLOW;
+	}
+	return COLOUR_BLACK;
+}
+
+// Compose one column of the highway for the current beat (the ghost
+// note, if this is the first column, and any note in the column).
+// This only changes the LED matrix's copy of the display.
+static void draw_column(uint8_t col)
+{
+	PixelColour colours[4];
+	for (uint8_t lane = 0; lane < 4; lane++)
+	{
+		colours[lane] = background_colour(col);
+	}
+	
+	if (col == 0)
+	{
+		// Ghost note implementation:
+		// index of which note in the track to play
+		uint16_t index = (MATRIX_NUM_COLUMNS+beat)/5;
+		// if the index is beyond the end of the track,
+		// no note can be drawn
+		if (index < track_length)
 		{
-			continue;
+			for (uint8_t lane = 0; lane < 4; lane++)
+			{
+				if (get_event(ghost_event)->lanes & (1<<lane))
+				{
+					if (combo_score >= 3)
+					{
+						colours[lane] = COLOUR_DARK_ORANGE;
+					}
+					else
+					{
+						colours[lane] = COLOUR_HALF_RED;
+					}
+				}
+			}
 		}
+	}
+	
+	// col counts from one end, future from the other
+	uint8_t future = MATRIX_NUM_COLUMNS-1-col;
+	// index of which note in the track to play
+	uint16_t index = (future+beat)/5;
+	
+	// the trail of a hold note runs through every column up to and
+	// including the last row it is held through, so this column has a
+	// trail if the row in it or the next row to come has a tail
+	uint16_t tail_row = (future+beat+4)/5;
+	if (tail_row < track_length)
+	{
+		uint8_t tails = event_in_row(tail_row)->lanes;
 		for (uint8_t lane = 0; lane < 4; lane++)
 		{
-			if (track[index] & (1<<lane))
+			if (tails & TAIL(lane))
 			{
-				if (col == 15)
+				if ((holding & (1<<lane)) && col >= SCORING_AREA_START)
 				{
-					if (!green_note)
-					{
-						// turning OFF audio
-						turn_off_audio = true;
-						
-						combo_score = 0;
-						game_score--;
-						print_game_score(game_score);
-						
-						//Printing combo score
-						move_terminal_cursor(10, 22);
-						printf("COMBO SCORE: %2d", combo_score);
-					}
-					green_note = 0;
+					colours[lane] = COLOUR_HALF_GREEN;
 				}
-				
-				PixelColour colour;
-				// yellows in the scoring area
-				if (col==11 || col == 15)
+				else if (combo_score >= 3)
 				{
-					colour = COLOUR_QUART_YELLOW;
+					colours[lane] = COLOUR_DARK_ORANGE;
 				}
-				else if (col==12 || col == 14)
+				else
 				{
-					colour = COLOUR_HALF_YELLOW;
+					colours[lane] = COLOUR_HALF_RED;
 				}
-				else if (col==13)
+			}
+		}
+	}
+	
+	// notes are only drawn every five columns, and only if the
+	// index is within the track
+	if (!((future+beat)%5) && index < track_length)
+	{
+		const NoteEvent* event = event_in_row(index);
+		// iterate over the four paths
+		for (uint8_t lane = 0; lane < 4; lane++)
+		{
+			// check if there's a note in the specific path
+			if (event->lanes & (1<<lane))
+			{
+				if (event->hit & (1<<lane))
 				{
-					colour = COLOUR_YELLOW;
+					colours[lane] = COLOUR_GREEN;
+				}
+				else if (combo_score >= 3)
+				{
+					colours[lane] = COLOUR_ORANGE;
 				}
 				else
 				{
-					colour = COLOUR_BLACK;
+					colours[lane] = COLOUR_RED;
 				}
-				
-				ledmatrix_update_pixel(col, 2*lane, colour);
-				ledmatrix_update_pixel(col, 2*lane+1, colour);
 			}
 		}
 	}
 	
-	// increment the beat
-	beat++;
-	
-	// Ghost note implementation below:
-
-	// Clearing the top row
-	ledmatrix_update_column(-1, COLOUR_BLACK);
-	// index of which note in the track to play
-	uint8_t index = (MATRIX_NUM_COLUMNS+beat)/5;
-	// if the index is beyond the end of the track,
-	// no note can be drawn
-	if (!(index >= TRACK_LENGTH))
+	for (uint8_t lane = 0; lane < 4; lane++)
 	{
-		// Drawing the ghost note
-		uint8_t next_note = find_next_valid_note(index);
+		ledmatrix_draw_pixel(col, 2*lane, colours[lane]);
+		ledmatrix_draw_pixel(col, 2*lane+1, colours[lane]);
+	}
+}
 
-		for (uint8_t lane=0; lane<4; lane++)
-		{	
-			if (next_note)
+// Advance the notes one row down the display
+void advance_note(void)
+{
+	// Check the notes leaving the scoring area (column 15). Any which
+	// weren't played are misses.
+	uint16_t index = beat / 5;
+	if (!(beat % 5) && index < track_length)
+	{
+		const NoteEvent* event = event_in_row(index);
+		for (uint8_t lane = 0; lane < 4; lane++)
+		{
+			if (event->lanes & (1<<lane))
 			{
-				if (track[next_note] & (1<<lane))
+				if (!(event->hit & (1<<lane)))
 				{
-					PixelColour color;
-					if (combo_score >= 3)
-					{
-						color = COLOUR_DARK_ORANGE;
-					}
-					else
-					{
-						color = COLOUR_HALF_RED;
-					}
-					ledmatrix_update_pixel(0, 2*lane, color);
-					ledmatrix_update_pixel(0, 2*lane+1, color);
+					// turning OFF audio
+					turn_off_audio = true;
+					
+					combo_score = 0;
+					game_score--;
+					print_game_score(game_score);
+					print_combo_score();
 				}
 			}
 		}
+		
+		// The trails going on to the next row go past the end of the
+		// highway for the next five beats. Stop holding the notes whose
+		// trail doesn't.
+		uint8_t continuing = event_in_row(index + 1)->lanes >> 4;
+		trailing = continuing;
+		if (holding & ~continuing)
+		{
+			holding &= continuing;
+			if (!holding)
+			{
+				// turning OFF audio
+				turn_off_audio = true;
+			}
+		}
 	}
 	
-	// draw the new notes
-	for (uint8_t col=0; col<MATRIX_NUM_COLUMNS; col++)
+	// Score the held notes whose trail is going past the end of the
+	// highway during this beat
+	uint8_t held = holding & trailing;
+	if (held)
 	{
-		// col counts from one end, future from the other
-		uint8_t future = MATRIX_NUM_COLUMNS-1-col;
-		
-		// index of which note in the track to play
-		uint8_t index = (future+beat)/5;
-		// if the index is beyond the end of the track,
-		// no note can be drawn
-		if (index >= TRACK_LENGTH)
+		for (uint8_t lane = 0; lane < 4; lane++)
 		{
-			continue;
+			if (held & (1<<lane))
+			{
+				game_score++;
+			}
 		}
-		
-		// notes are only drawn every five columns
-		if ((future+beat)%5)
+		print_game_score(game_score);
+	}
+	
+	// increment the beat, and drop the events which have left the highway
+	beat++;
+	while (get_event(first_event)->row < track_length
+			&& 5*get_event(first_event)->row < beat)
+	{
+		first_event++;
+	}
+	update_ghost_event();
+	
+	bool orange = combo_score >= 3;
+	if (!highway_drawn || orange != highway_orange)
+	{
+		// Nothing has been drawn yet, or the note colour has changed -
+		// draw the whole highway.
+		for (uint8_t col = 0; col < MATRIX_NUM_COLUMNS; col++)
 		{
-			continue;
+			draw_column(col);
 		}
-
-		// iterate over the four paths
-		for (uint8_t lane=0; lane<4; lane++)
-		{	
-			// check if there's a note in the specific path
-			if (track[index] & (1<<lane))
-			{	
-				PixelColour colour;
-				
-				if (green_note && col>=11)
-				{
-					colour = COLOUR_GREEN;
-				}
-				else
-				{
-					if (combo_score >= 3)
-					{
-						colour = COLOUR_ORANGE;
-					}
-					else
-					{
-						colour = COLOUR_RED;
-					}
-				}
-				// if so, colour the two pixels red
-				ledmatrix_update_pixel(col, 2*lane, colour);
-				ledmatrix_update_pixel(col, 2*lane+1, colour);
-			}
+		highway_drawn = true;
+		highway_orange = orange;
+	}
+	else
+	{
+		// Every note moves one column to the right, which the matrix can
+		// do by itself with a single shift command. We then only need to
+		// draw the newly revealed column, the column the ghost note was
+		// in, and the scoring area (whose yellow background was shifted
+		// along with the notes, and where notes may have turned green).
+		ledmatrix_draw_shift_right();
+		draw_column(0);
+		draw_column(1);
+		for (uint8_t col = 11; col < MATRIX_NUM_COLUMNS; col++)
+		{
+			draw_column(col);
 		}
 	}
 }
@@ -446,24 +619,27 @@ uint8_t is_game_over(void)
 {
 	// YOUR CODE HERE
 	// Detect if the game is over i.e. if a player has won.
-	return beat >= 5*TRACK_LENGTH-30;
+	return beat + 30 >= 5*track_length;
 }
 
-// Returns the index of next valid note, 0 otherwise.
-uint8_t find_next_valid_note(uint8_t index)
+// Returns 1 if a hold note is being held, 0 otherwise.
+int is_long_note_being_played(void)
 {
-	for (uint8_t next_note = index+1; next_note < TRACK_LENGTH; next_note++)
-	{
-		if (track[next_note] & 0x0F)
-		{
-			return next_note;
-		}
-	}
-	return 0;
+	return holding != 0;
+}
+
+void draw_game_status(void)
+{
+	status_field_draw(&score_field, game_score);
+	status_field_draw(&combo_field, combo_score);
 }
 
 void print_game_score(int score)
 {
-	move_terminal_cursor(10, 14);
-	printf("Game Score: %4d", score);
+	status_field_update(&score_field, score);
+}
+
+void print_combo_score(void)
+{
+	status_field_update(&combo_field, combo_score);
 }
\ No newline at end of file
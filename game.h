@@ -14,8 +14,8 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "timer0.h"
 
-#define TRACK_LENGTH 129
 int16_t game_score;
 uint8_t combo_score;
 uint16_t freq;	// Hz
@@ -32,18 +32,43 @@ uint8_t track_choice;
 // Initialise the game by resetting the grid and beat
 void initialise_game(void);
 
-// Play a note in the given lane
-void play_note(uint8_t lane);
+// play_note() and advance_note() draw into the LED matrix's back buffer.
+// Call ledmatrix_flush() to show the result.
+
+// Play a note in the given lane, pushed at the given beat clock time (see
+// timer0.h). The note is scored by how close that was to the time the
+// note arrived in the middle of the scoring area. If it is a hold note it
+// is held until release_note() - unless can_hold is false (e.g. it was
+// played with a key, which can't be held down).
+void play_note(uint8_t lane, const BeatTime* time, bool can_hold);
+
+// Release the button for the given lane (ending any hold note in it)
+void release_note(uint8_t lane);
 
 // Advance the notes one row down the display
 void advance_note(void);
 
 // Returns 1 if the game is over, 0 otherwise.
 uint8_t is_game_over(void);
-// Returns the index of next note
-uint8_t find_next_valid_note(uint8_t index);
 
+// Draw the score and combo on the terminal (after it has been cleared),
+// and update them when they change. Only the digits which change are
+// sent, so these are quick enough to call for every note.
+void draw_game_status(void);
 void print_game_score(int score);
+void print_combo_score(void);
+
+// How well a note was played - it is judged PERFECT, GREAT or GOOD by
+// how near its arrival time it was played
+#define PERFECT	0
+#define GREAT	1
+#define GOOD	2
+#define NUM_JUDGEMENT_CLASSES	3
+
+// Return the number of notes given the judgement (PERFECT, GREAT or GOOD)
+// so far in this game
+uint16_t judgement_count(uint8_t judgement);
 
+// Returns 1 if a hold note is being held, 0 otherwise.
 int is_long_note_being_played(void);
 #endif
@@ -8,8 +8,8 @@
 
 #include "ledmatrix.h"
 #include <stdint.h>
-#include <avr/io.h>
 #include "spi.h"
+#include "palette.h"
 
 #define CMD_UPDATE_ALL		(0x00)
 #define CMD_UPDATE_PIXEL	(0x01)
@@ -18,22 +18,87 @@
 #define CMD_SHIFT_DISPLAY	(0x04)
 #define CMD_CLEAR_SCREEN	(0x0F)
 
+// Number of bytes sent by each of the update commands
+#define PIXEL_CMD_BYTES		3
+#define COL_CMD_BYTES		(2 + MATRIX_NUM_ROWS)
+#define ROW_CMD_BYTES		(2 + MATRIX_NUM_COLUMNS)
+#define ALL_CMD_BYTES		(1 + MATRIX_NUM_ROWS * MATRIX_NUM_COLUMNS)
+#define SHIFT_CMD_BYTES		2
+
+// Two copies of the display: the front buffer holds what the matrix is
+// showing (or will be showing once the SPI queue has been sent) and the
+// back buffer holds the next frame as it is drawn. Bit y of dirty[x] is
+// set when back_buffer[x][y] differs from front_buffer[x][y], i.e. when
+// that pixel must be sent by ledmatrix_flush(). back_buffer_shift counts
+// how many columns the back buffer has been shifted right since the last
+// flush. Both buffers are stored packed (see palette.h) - colours are only
+// expanded when they are queued for sending.
+static PackedMatrixData front_buffer;
+static PackedMatrixData back_buffer;
+static uint8_t dirty[MATRIX_NUM_COLUMNS];
+static uint8_t back_buffer_shift;
+
+static LedMatrixFlushStats flush_stats;
+
+// Record that the matrix now shows the given colour at (x,y) - used by
+// the functions which send more than one pixel at a time.
+static void set_shown(uint8_t x, uint8_t y, PaletteIndex index)
+{
+	packed_set_index(front_buffer, x, y, index);
+	packed_set_index(back_buffer, x, y, index);
+	dirty[x] &= ~(1 << y);
+}
+
+static void send_pixel(uint8_t x, uint8_t y, PaletteIndex index)
+{
+	spi_queue_byte(CMD_UPDATE_PIXEL);
+	spi_queue_byte(((y & 0x07) << 4) | (x & 0x0F));
+	spi_queue_byte(palette_colour(index));
+	set_shown(x, y, index);
+}
+
+// Shift the columns of the given buffer one to the right. The first
+// column becomes black.
+static void shift_buffer_right(PackedMatrixData buffer)
+{
+	for (uint8_t x = MATRIX_NUM_COLUMNS - 1; x > 0; x--)
+	{
+		packed_copy_column(buffer[x - 1], buffer[x]);
+	}
+	packed_fill_column(buffer[0], COLOUR_BLACK);
+}
+
+// Work out which pixels of column x differ between the two buffers
+static void update_dirty_column(uint8_t x)
+{
+	dirty[x] = packed_column_differences(front_buffer[x], back_buffer[x]);
+}
+
 void ledmatrix_setup(void)
 {
 	// Setup SPI - we divide the clock by 128.
 	// (This speed guarantees the SPI buffer will never overflow on
 	// the LED matrix.)
 	spi_setup_master(128);
+	
+	// We don't know what the matrix is showing, so clear it. This also
+	// clears our copy of the display.
+	ledmatrix_clear();
 }
 
 void ledmatrix_update_all(MatrixData data)
 {
-	(void)spi_send_byte(CMD_UPDATE_ALL);
+	back_buffer_shift = 0;
+	spi_queue_byte(CMD_UPDATE_ALL);
 	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++)
 	{
 		for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
 		{
-			(void)spi_send_byte(data[x][y]);
+			// Send the palette colour nearest to the one given, so that
+			// what we record as shown is what the matrix shows
+			PaletteIndex index = palette_index(data[x][y]);
+			spi_queue_byte(palette_colour(index));
+			set_shown(x, y, index);
 		}
 	}
 }
@@ -45,9 +110,15 @@ void ledmatrix_update_pixel(uint8_t x, uint8_t y, PixelColour pixel)
 		// Position isn't valid - we ignore the request.
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_PIXEL);
-	(void)spi_send_byte(((y & 0x07) << 4) | (x & 0x0F));
-	(void)spi_send_byte(pixel);
+	PaletteIndex index = palette_index(pixel);
+	if (packed_get_index(front_buffer, x, y) == index)
+	{
+		// The matrix already shows this colour - nothing to send, but
+		// forget about any back_buffer change to this pixel.
+		set_shown(x, y, index);
+		return;
+	}
+	send_pixel(x, y, index);
 }
 
 void ledmatrix_update_row(uint8_t y, MatrixRow row)
@@ -57,11 +128,13 @@ void ledmatrix_update_row(uint8_t y, MatrixRow row)
 		// y value is too large - we ignore the request
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_ROW);
-	(void)spi_send_byte(y & 0x07);	// row number
+	spi_queue_byte(CMD_UPDATE_ROW);
+	spi_queue_byte(y & 0x07);	// row number
 	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
 	{
-		(void)spi_send_byte(row[x]);
+		PaletteIndex index = palette_index(row[x]);
+		spi_queue_byte(palette_colour(index));
+		set_shown(x, y, index);
 	}
 }
 
@@ -72,41 +145,364 @@ void ledmatrix_update_column(uint8_t x, MatrixColumn col)
 		// x value is too large - we ignore the request
 		return;
 	}
-	(void)spi_send_byte(CMD_UPDATE_COL);
-	(void)spi_send_byte(x & 0x0F); // column number
+	spi_queue_byte(CMD_UPDATE_COL);
+	spi_queue_byte(x & 0x0F); // column number
 	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++)
 	{
-		(void)spi_send_byte(col[y]);
+		PaletteIndex index = palette_index(col[y]);
+		spi_queue_byte(palette_colour(index));
+		set_shown(x, y, index);
+	}
+}
+
+// If the back buffer has been shifted since the last flush, flush it
+// before shifting the display, so that the frame's shift isn't mixed up
+// with this one
+static void flush_pending_shift(void)
+{
+	if (back_buffer_shift)
+	{
+		ledmatrix_flush();
 	}
 }
 
 void ledmatrix_shift_display_left(void)
 {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x02);
+	flush_pending_shift();
+	spi_queue_byte(CMD_SHIFT_DISPLAY);
+	spi_queue_byte(0x02);
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS - 1; x++)
+	{
+		packed_copy_column(front_buffer[x + 1], front_buffer[x]);
+		packed_copy_column(back_buffer[x + 1], back_buffer[x]);
+		dirty[x] = dirty[x + 1];
+	}
+	packed_fill_column(front_buffer[MATRIX_NUM_COLUMNS - 1], COLOUR_BLACK);
+	packed_fill_column(back_buffer[MATRIX_NUM_COLUMNS - 1], COLOUR_BLACK);
+	dirty[MATRIX_NUM_COLUMNS - 1] = 0;
 }
 
 void ledmatrix_shift_display_right(void)
 {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x01);
+	flush_pending_shift();
+	spi_queue_byte(CMD_SHIFT_DISPLAY);
+	spi_queue_byte(0x01);
+	shift_buffer_right(front_buffer);
+	shift_buffer_right(back_buffer);
+	for (uint8_t x = MATRIX_NUM_COLUMNS - 1; x > 0; x--)
+	{
+		dirty[x] = dirty[x - 1];
+	}
+	dirty[0] = 0;
 }
 
 void ledmatrix_shift_display_up(void)
 {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x08);
+	flush_pending_shift();
+	spi_queue_byte(CMD_SHIFT_DISPLAY);
+	spi_queue_byte(0x08);
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		for (uint8_t y = MATRIX_NUM_ROWS - 1; y > 0; y--)
+		{
+			packed_set_index(front_buffer, x, y,
+					packed_get_index(front_buffer, x, y - 1));
+			packed_set_index(back_buffer, x, y,
+					packed_get_index(back_buffer, x, y - 1));
+		}
+		packed_set_index(front_buffer, x, 0, PALETTE_BLACK);
+		packed_set_index(back_buffer, x, 0, PALETTE_BLACK);
+		dirty[x] <<= 1;
+	}
 }
 
 void ledmatrix_shift_display_down(void)
 {
-	(void)spi_send_byte(CMD_SHIFT_DISPLAY);
-	(void)spi_send_byte(0x04);
+	flush_pending_shift();
+	spi_queue_byte(CMD_SHIFT_DISPLAY);
+	spi_queue_byte(0x04);
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS - 1; y++)
+		{
+			packed_set_index(front_buffer, x, y,
+					packed_get_index(front_buffer, x, y + 1));
+			packed_set_index(back_buffer, x, y,
+					packed_get_index(back_buffer, x, y + 1));
+		}
+		packed_set_index(front_buffer, x, MATRIX_NUM_ROWS - 1, PALETTE_BLACK);
+		packed_set_index(back_buffer, x, MATRIX_NUM_ROWS - 1, PALETTE_BLACK);
+		dirty[x] >>= 1;
+	}
 }
 
 void ledmatrix_clear(void)
 {
-	(void)spi_send_byte(CMD_CLEAR_SCREEN);
+	spi_queue_byte(CMD_CLEAR_SCREEN);
+	packed_fill(front_buffer, COLOUR_BLACK);
+	packed_fill(back_buffer, COLOUR_BLACK);
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		dirty[x] = 0;
+	}
+	back_buffer_shift = 0;
+}
+
+void ledmatrix_draw_pixel(uint8_t x, uint8_t y, PixelColour pixel)
+{
+	if (x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS)
+	{
+		// Position isn't valid - we ignore the request.
+		return;
+	}
+	PaletteIndex index = palette_index(pixel);
+	packed_set_index(back_buffer, x, y, index);
+	if (packed_get_index(front_buffer, x, y) == index)
+	{
+		dirty[x] &= ~(1 << y);
+	}
+	else
+	{
+		dirty[x] |= (1 << y);
+	}
+}
+
+PixelColour ledmatrix_get_pixel(uint8_t x, uint8_t y)
+{
+	if (x >= MATRIX_NUM_COLUMNS || y >= MATRIX_NUM_ROWS)
+	{
+		return COLOUR_BLACK;
+	}
+	return packed_get_pixel(back_buffer, x, y);
+}
+
+// Return the number of bits set in the given byte
+static uint8_t count_bits(uint8_t bits)
+{
+	uint8_t count = 0;
+	while (bits)
+	{
+		bits &= bits - 1;
+		count++;
+	}
+	return count;
+}
+
+// Send every dirty pixel in row y as a pixel command
+static void send_dirty_pixels_in_row(uint8_t y)
+{
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		if (dirty[x] & (1 << y))
+		{
+			send_pixel(x, y, packed_get_index(back_buffer, x, y));
+		}
+	}
+}
+
+// Send the whole of the back buffer
+static void send_all(void)
+{
+	spi_queue_byte(CMD_UPDATE_ALL);
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++)
+	{
+		for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+		{
+			spi_queue_byte(packed_get_pixel(back_buffer, x, y));
+		}
+	}
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		packed_copy_column(back_buffer[x], front_buffer[x]);
+		dirty[x] = 0;
+	}
+}
+
+static void send_row(uint8_t y)
+{
+	MatrixRow row;
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		row[x] = packed_get_pixel(back_buffer, x, y);
+	}
+	ledmatrix_update_row(y, row);
+}
+
+void ledmatrix_flush(void)
+{
+	// Send only the pixels which have changed since they were last sent.
+	// Pixels which were drawn over and then put back to their original
+	// colour cost nothing. The changed pixels are sent with whichever mix
+	// of pixel, row, column and whole display commands needs the fewest
+	// bytes. We consider three ways of sending them:
+	// 1) rows: each row with enough changed pixels is sent whole, the
+	//    rest of the changes are sent as pixels
+	// 2) columns: the same rows are sent whole, and the changes left in
+	//    each column are sent as a column or as pixels
+	// 3) everything: the whole display is sent
+	// Everything for the frame is queued in one go, so the matrix never
+	// shows part of a frame for longer than it takes to send it.
+	uint8_t naive_changes = 0;
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		naive_changes += count_bits(dirty[x]);
+	}
+	if (naive_changes == 0 && back_buffer_shift == 0)
+	{
+		// Nothing to send
+		return;
+	}
+	
+	// If the back buffer has been shifted, the matrix can shift what it is
+	// showing by itself - afterwards only the pixels which don't match the
+	// shifted display need to be sent.
+	uint8_t shift = back_buffer_shift;
+	back_buffer_shift = 0;
+	if (shift)
+	{
+		for (uint8_t i = 0; i < shift; i++)
+		{
+			shift_buffer_right(front_buffer);
+		}
+		for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+		{
+			update_dirty_column(x);
+		}
+	}
+	
+	uint8_t row_changes[MATRIX_NUM_ROWS];
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++)
+	{
+		row_changes[y] = 0;
+		for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+		{
+			if (dirty[x] & (1 << y))
+			{
+				row_changes[y]++;
+			}
+		}
+	}
+	
+	uint8_t whole_rows = 0;
+	uint16_t row_cost = 0;
+	for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++)
+	{
+		if (row_changes[y] * PIXEL_CMD_BYTES > ROW_CMD_BYTES)
+		{
+			whole_rows |= (1 << y);
+			row_cost += ROW_CMD_BYTES;
+		}
+		else
+		{
+			row_cost += row_changes[y] * PIXEL_CMD_BYTES;
+		}
+	}
+	
+	uint16_t column_cost = count_bits(whole_rows) * ROW_CMD_BYTES;
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		uint8_t changes = count_bits(dirty[x] & ~whole_rows) * PIXEL_CMD_BYTES;
+		column_cost += (changes > COL_CMD_BYTES) ? COL_CMD_BYTES : changes;
+	}
+	
+	// The shift commands are only needed if we aren't sending the
+	// whole display
+	uint16_t shift_cost = shift * SHIFT_CMD_BYTES;
+	row_cost += shift_cost;
+	column_cost += shift_cost;
+	
+	uint16_t cost;
+	if (ALL_CMD_BYTES <= row_cost && ALL_CMD_BYTES <= column_cost)
+	{
+		cost = ALL_CMD_BYTES;
+		send_all();
+		flush_stats.bytes_sent += cost;
+		flush_stats.naive_bytes += naive_changes * PIXEL_CMD_BYTES;
+		return;
+	}
+	
+	for (uint8_t i = 0; i < shift; i++)
+	{
+		spi_queue_byte(CMD_SHIFT_DISPLAY);
+		spi_queue_byte(0x01);
+	}
+	if (row_cost < column_cost)
+	{
+		cost = row_cost;
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++)
+		{
+			if (whole_rows & (1 << y))
+			{
+				send_row(y);
+			}
+			else
+			{
+				send_dirty_pixels_in_row(y);
+			}
+		}
+	}
+	else
+	{
+		cost = column_cost;
+		for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++)
+		{
+			if (whole_rows & (1 << y))
+			{
+				send_row(y);
+			}
+		}
+		for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+		{
+			if (count_bits(dirty[x]) * PIXEL_CMD_BYTES > COL_CMD_BYTES)
+			{
+				MatrixColumn column;
+				packed_expand_column(back_buffer[x], column);
+				ledmatrix_update_column(x, column);
+			}
+			else
+			{
+				for (uint8_t y = 0; y < MATRIX_NUM_ROWS; y++)
+				{
+					if (dirty[x] & (1 << y))
+					{
+						send_pixel(x, y, packed_get_index(back_buffer, x, y));
+					}
+				}
+			}
+		}
+	}
+	
+	flush_stats.bytes_sent += cost;
+	flush_stats.naive_bytes += naive_changes * PIXEL_CMD_BYTES;
+}
+
+uint8_t ledmatrix_flush_complete(void)
+{
+	return spi_is_idle();
+}
+
+void ledmatrix_draw_shift_right(void)
+{
+	shift_buffer_right(back_buffer);
+	if (back_buffer_shift < MATRIX_NUM_COLUMNS)
+	{
+		back_buffer_shift++;
+	}
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		update_dirty_column(x);
+	}
+}
+
+void ledmatrix_get_flush_stats(LedMatrixFlushStats* stats)
+{
+	*stats = flush_stats;
+}
+
+void ledmatrix_reset_flush_stats(void)
+{
+	flush_stats.bytes_sent = 0;
+	flush_stats.naive_bytes = 0;
 }
 
 void copy_matrix_column(MatrixColumn from, MatrixColumn to)
@@ -26,7 +26,9 @@ typedef PixelColour MatrixColumn[MATRIX_NUM_ROWS];
 // below are used.
 void ledmatrix_setup(void);
 
-// Functions to update the display
+// Functions to update the display. The commands are queued for sending
+// by the SPI interrupt handler (see spi.h) and these return immediately;
+// use spi_wait_until_idle() if the matrix must be up to date.
 // For those functions which take an x or a y value, the value must be valid
 // or the request will be ignored. (i.e. x must be < MATRIX_NUM_COLUMNS
 // and y must be < MATRIX_NUM_ROWS)
@@ -40,6 +42,44 @@ void ledmatrix_shift_display_up(void);
 void ledmatrix_shift_display_down(void);
 void ledmatrix_clear(void);
 
+// Functions to compose the display in RAM. Two copies of the display are
+// kept: a front buffer holding what the matrix is showing, and a back
+// buffer into which the next frame is drawn. Drawing into the back buffer
+// never sends anything. ledmatrix_flush() commits the frame: it sends only
+// those pixels which differ from what the matrix is showing, using
+// whichever mix of pixel, row, column, shift and whole display commands
+// takes the fewest bytes. All the commands for the frame are queued at
+// once, so the matrix never shows a half drawn frame, and the function
+// returns without waiting for them to be sent. ledmatrix_flush_complete()
+// returns non-zero once they have been sent - the next frame can be drawn
+// in the meantime. (The update functions above keep both copies in step,
+// and an update_pixel() which doesn't change the pixel is not sent. If
+// ledmatrix_draw_shift_right() has been called since the last flush, the
+// shift_display functions flush the frame before shifting.)
+// Both copies are stored packed, 4 bits per pixel (see palette.h), so a
+// colour which isn't in the palette is kept (and later sent) as the
+// nearest colour which is. The update functions below send that nearest
+// colour too, so the matrix always shows what our copy records.
+void ledmatrix_draw_pixel(uint8_t x, uint8_t y, PixelColour pixel);
+PixelColour ledmatrix_get_pixel(uint8_t x, uint8_t y);
+// Shift the back buffer one column to the right. The first column becomes
+// black. (The matrix's shift command will be used when the frame is sent.)
+void ledmatrix_draw_shift_right(void);
+void ledmatrix_flush(void);
+uint8_t ledmatrix_flush_complete(void);
+
+// Count of the bytes sent by ledmatrix_flush(), and of the bytes which
+// would have been sent if every changed pixel was sent with its own
+// pixel command.
+typedef struct
+{
+	uint32_t bytes_sent;
+	uint32_t naive_bytes;
+} LedMatrixFlushStats;
+
+void ledmatrix_get_flush_stats(LedMatrixFlushStats* stats);
+void ledmatrix_reset_flush_stats(void);
+
 // Functions to operate on MatrixRow and MatrixColumn data structures
 void copy_matrix_column(MatrixColumn from, MatrixColumn to);
 void copy_matrix_row(MatrixRow from, MatrixRow to);
@@ -0,0 +1,153 @@
+/*
+ * palette.c
+ *
+ * Packed storage for LED matrix display data - see palette.h.
+ */
+
+#include "palette.h"
+#include <stdint.h>
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+// Allow the display code to be built on the host (see tools/host_spi.c)
+#define PROGMEM
+#define pgm_read_byte(address) (*(address))
+#endif
+
+// The palette. The colours used by the game come first; the rest fill in
+// the gaps between them.
+static const PixelColour palette[PALETTE_SIZE] PROGMEM = {
+	COLOUR_BLACK,
+	COLOUR_RED,
+	COLOUR_ORANGE,
+	COLOUR_GREEN,
+	COLOUR_QUART_YELLOW,
+	COLOUR_HALF_YELLOW,
+	COLOUR_YELLOW,
+	COLOUR_HALF_RED,
+	COLOUR_DARK_ORANGE,
+	0x07,	// dim red
+	0x10,	// dim green
+	0x70,	// half green
+	0x33,	// dim yellow
+	0x99,	// bright yellow
+	0x7F,	// light orange
+	0xF7	// yellow green
+	};
+
+// The palette index of every colour, so that storing a pixel is a single
+// lookup. A colour in the palette has its own index; any other has the
+// index of the nearest palette colour, measured as the difference in red
+// plus the difference in green (the first in the palette if two are as
+// near). This must be remade if the palette is changed.
+static const PaletteIndex palette_indices[256] PROGMEM = {
+	 0,  7,  7,  7,  7,  9,  9,  9,  9,  9,  9,  1,  1,  1,  1,  1,	// 0x00 to 0x0F
+	10,  4,  4,  4,  4,  9,  9,  9,  9,  9,  2,  2,  2,  8,  8,  8,	// 0x10 to 0x1F
+	10,  4,  4, 12, 12,  5,  9,  9,  9,  2,  2,  2,  2,  2,  8,  8,	// 0x20 to 0x2F
+	10,  4, 12, 12, 12,  5,  5,  9,  2,  2,  2,  2,  2,  2,  2,  8,	// 0x30 to 0x3F
+	10,  4, 12, 12,  5,  5,  5,  5,  5,  2,  2,  2,  2,  2,  2,  8,	// 0x40 to 0x4F
+	11, 11,  5,  5,  5,  5,  5,  5,  5,  5,  2,  2,  2,  2, 14, 14,	// 0x50 to 0x5F
+	11, 11, 11,  5,  5,  5,  5,  5,  5, 13, 13,  2,  2, 14, 14, 14,	// 0x60 to 0x6F
+	11, 11, 11, 11,  5,  5,  5,  5, 13, 13, 13, 13, 14, 14, 14, 14,	// 0x70 to 0x7F
+	11, 11, 11, 11,  5,  5,  5, 13, 13, 13, 13, 13, 13, 14, 14, 14,	// 0x80 to 0x8F
+	11, 11, 11, 11,  5,  5, 13, 13, 13, 13, 13, 13, 13, 13, 14, 14,	// 0x90 to 0x9F
+	11, 11, 11, 11,  5,  5, 13, 13, 13, 13, 13, 13, 13, 13, 14, 14,	// 0xA0 to 0xAF
+	 3,  3,  3,  3,  5,  5, 13, 13, 13, 13, 13, 13, 13,  6,  6,  6,	// 0xB0 to 0xBF
+	 3,  3,  3,  3, 15, 15, 15, 15, 13, 13, 13, 13,  6,  6,  6,  6,	// 0xC0 to 0xCF
+	 3,  3,  3,  3, 15, 15, 15, 15, 15, 13, 13,  6,  6,  6,  6,  6,	// 0xD0 to 0xDF
+	 3,  3,  3,  3, 15, 15, 15, 15, 15, 15, 15,  6,  6,  6,  6,  6,	// 0xE0 to 0xEF
+	 3,  3,  3,  3, 15, 15, 15, 15, 15, 15, 15,  6,  6,  6,  6,  6	// 0xF0 to 0xFF
+	};
+
+PaletteIndex palette_index(PixelColour colour)
+{
+	return pgm_read_byte(&palette_indices[colour]);
+}
+
+PixelColour palette_colour(PaletteIndex index)
+{
+	return pgm_read_byte(&palette[index & (PALETTE_SIZE - 1)]);
+}
+
+PaletteIndex packed_get_index(PackedMatrixData data, uint8_t x, uint8_t y)
+{
+	uint8_t pair = data[x][y >> 1];
+	return (y & 1) ? pair >> 4 : pair & 0x0F;
+}
+
+void packed_set_index(PackedMatrixData data, uint8_t x, uint8_t y,
+		PaletteIndex index)
+{
+	uint8_t* pair = &data[x][y >> 1];
+	if (y & 1)
+	{
+		*pair = (*pair & 0x0F) | (index << 4);
+	}
+	else
+	{
+		*pair = (*pair & 0xF0) | (index & 0x0F);
+	}
+}
+
+PixelColour packed_get_pixel(PackedMatrixData data, uint8_t x, uint8_t y)
+{
+	return palette_colour(packed_get_index(data, x, y));
+}
+
+void packed_set_pixel(PackedMatrixData data, uint8_t x, uint8_t y,
+		PixelColour colour)
+{
+	packed_set_index(data, x, y, palette_index(colour));
+}
+
+void packed_copy_column(PackedMatrixColumn from, PackedMatrixColumn to)
+{
+	for (uint8_t i = 0; i < MATRIX_NUM_ROWS / 2; i++)
+	{
+		to[i] = from[i];
+	}
+}
+
+void packed_fill_column(PackedMatrixColumn column, PixelColour colour)
+{
+	PaletteIndex index = palette_index(colour);
+	for (uint8_t i = 0; i < MATRIX_NUM_ROWS / 2; i++)
+	{
+		column[i] = (index << 4) | index;
+	}
+}
+
+void packed_expand_column(PackedMatrixColumn from, MatrixColumn to)
+{
+	for (uint8_t i = 0; i < MATRIX_NUM_ROWS / 2; i++)
+	{
+		to[2 * i] = palette_colour(from[i] & 0x0F);
+		to[2 * i + 1] = palette_colour(from[i] >> 4);
+	}
+}
+
+void packed_fill(PackedMatrixData data, PixelColour colour)
+{
+	for (uint8_t x = 0; x < MATRIX_NUM_COLUMNS; x++)
+	{
+		packed_fill_column(data[x], colour);
+	}
+}
+
+uint8_t packed_column_differences(PackedMatrixColumn a, PackedMatrixColumn b)
+{
+	uint8_t differences = 0;
+	for (uint8_t i = 0; i < MATRIX_NUM_ROWS / 2; i++)
+	{
+		uint8_t changed = a[i] ^ b[i];
+		if (changed & 0x0F)
+		{
+			differences |= 1 << (2 * i);
+		}
+		if (changed & 0xF0)
+		{
+			differences |= 1 << (2 * i + 1);
+		}
+	}
+	return differences;
+}
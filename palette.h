@@ -0,0 +1,56 @@
+/*
+ * palette.h
+ *
+ * Packed storage for LED matrix display data. Rather than a byte per
+ * pixel (as in MatrixData), each pixel is stored as a 4 bit index into a
+ * table of 16 colours (the palette), so a whole display takes 64 bytes
+ * instead of 128. Colours are only expanded back to PixelColour values
+ * when they are needed, e.g. when they are sent to the matrix.
+ *
+ * The palette holds every colour defined in pixel_colour.h. Any other
+ * colour is stored as the nearest colour in the palette.
+ */
+
+#ifndef PALETTE_H_
+#define PALETTE_H_
+
+#include <stdint.h>
+#include "pixel_colour.h"
+#include "ledmatrix.h"
+
+#define PALETTE_SIZE 16
+
+// Index of a colour in the palette (0 to PALETTE_SIZE-1). Black is always
+// index 0, so zero filled data is a black display.
+typedef uint8_t PaletteIndex;
+#define PALETTE_BLACK 0
+
+// Packed display data. The pixel at (x,y) is stored in data[x][y/2] - in
+// the low 4 bits for even y and the high 4 bits for odd y - so each column
+// is 4 bytes.
+typedef uint8_t PackedMatrixData[MATRIX_NUM_COLUMNS][MATRIX_NUM_ROWS / 2];
+typedef uint8_t PackedMatrixColumn[MATRIX_NUM_ROWS / 2];
+
+// Convert between colours and palette indices
+PaletteIndex palette_index(PixelColour colour);
+PixelColour palette_colour(PaletteIndex index);
+
+// Get and set a single pixel. The position must be valid.
+PaletteIndex packed_get_index(PackedMatrixData data, uint8_t x, uint8_t y);
+void packed_set_index(PackedMatrixData data, uint8_t x, uint8_t y,
+		PaletteIndex index);
+PixelColour packed_get_pixel(PackedMatrixData data, uint8_t x, uint8_t y);
+void packed_set_pixel(PackedMatrixData data, uint8_t x, uint8_t y,
+		PixelColour colour);
+
+// Functions to operate on whole columns and displays
+void packed_copy_column(PackedMatrixColumn from, PackedMatrixColumn to);
+void packed_fill_column(PackedMatrixColumn column, PixelColour colour);
+void packed_expand_column(PackedMatrixColumn from, MatrixColumn to);
+void packed_fill(PackedMatrixData data, PixelColour colour);
+
+// Return a bit mask of the rows (bit y for row y) in which the two columns
+// hold different colours
+uint8_t packed_column_differences(PackedMatrixColumn a, PackedMatrixColumn b);
+
+#endif /* PALETTE_H_ */
@@ -18,6 +18,7 @@ typedef uint8_t PixelColour;
 #define COLOUR_RED			(0x0F)
 #define COLOUR_HALF_RED	    (0x01)
 #define COLOUR_GREEN		(0xF0)
+#define COLOUR_HALF_GREEN	(0x70)
 #define COLOUR_ORANGE		(0x3C)
 #define COLOUR_DARK_ORANGE  (0x1F)
 #define COLOUR_HALF_YELLOW  (0x55)
@@ -18,40 +18,60 @@
 #include <util/delay.h>
 
 #include "game.h"
+#include "beat_stats.h"
 #include "display.h"
 #include "ledmatrix.h"
+#include "sprite.h"
 #include "buttons.h"
+#include "chart_store.h"
+#include "tracks.h"
 #include "serialio.h"
 #include "terminalio.h"
 #include "timer0.h"
 #include "timer1.h"
 #include "timer2.h"
+#include "vterm.h"
 
 // Function prototypes - these are defined below (after main()) in the order
 // given here
 void initialise_hardware(void);
 void start_screen(void);
 void new_game(void);
+int8_t next_button_push(BeatTime* push_time);
 void play_game(void);
 void handle_game_over(void);
+void print_selected_track(void);
 
 uint16_t game_speed = 1000;
 bool manual_mode = false;
 bool game_over = false;
 int game_paused = 0;
-uint32_t paused_duration = 0;
-uint32_t paused_start = 0;
-
-const char *ASCII_ART_COMBO[10] = {"  ______                           __                  __ ",
-									" /      \\                         |  \\                |  \\",
-									"|  $$$$$$\\  ______   ______ ____  | $$____    ______  | $$",
-									"| $$   \\$$ /      \\ |      \\    \\ | $$    \\  /      \\ | $$",
-									"| $$      |  $$$$$$\\| $$$$$$\\$$$$\\| $$$$$$$\\|  $$$$$$\\| $$",
-									"| $$   __ | $$  | $$| $$ | $$ | $$| $$  | $$| $$  | $$ \\$$",
-									"| $$__/  \\| $$__/ $$| $$ | $$ | $$| $$__/ $$| $$__/ $$ __ ",
-									" \\$$    $$ \\$$    $$| $$ | $$ | $$| $$    $$ \\$$    $$|  \\",
-									"  \\$$$$$$   \\$$$$$$  \\$$  \\$$  \\$$ \\$$$$$$$   \\$$$$$$  \\$$",
-									""};
+
+// What to do when the notes have fallen more than one beat behind the
+// beat clock (e.g. because a frame took a long time to send):
+// CATCH_UP_SKIP advances them through all the missed beats at once, so
+// only the last of the missed frames is shown; CATCH_UP_BURST advances
+// them one beat each time around the game loop, showing every frame
+// until they have caught up. Either way the beats that follow are due
+// at the same times - a late beat doesn't push the rest back.
+#define CATCH_UP_SKIP	0
+#define CATCH_UP_BURST	1
+#define CATCH_UP_POLICY	CATCH_UP_SKIP
+
+// The banner shown below the score while the combo is 3 or more
+#define COMBO_ART_ROWS 9
+static const char combo_art_0[] PROGMEM = "  ______                           __                  __ ";
+static const char combo_art_1[] PROGMEM = " /      \\                         |  \\                |  \\";
+static const char combo_art_2[] PROGMEM = "|  $$$$$$\\  ______   ______ ____  | $$____    ______  | $$";
+static const char combo_art_3[] PROGMEM = "| $$   \\$$ /      \\ |      \\    \\ | $$    \\  /      \\ | $$";
+static const char combo_art_4[] PROGMEM = "| $$      |  $$$$$$\\| $$$$$$\\$$$$\\| $$$$$$$\\|  $$$$$$\\| $$";
+static const char combo_art_5[] PROGMEM = "| $$   __ | $$  | $$| $$ | $$ | $$| $$  | $$| $$  | $$ \\$$";
+static const char combo_art_6[] PROGMEM = "| $$__/  \\| $$__/ $$| $$ | $$ | $$| $$__/ $$| $$__/ $$ __ ";
+static const char combo_art_7[] PROGMEM = " \\$$    $$ \\$$    $$| $$ | $$ | $$| $$    $$ \\$$    $$|  \\";
+static const char combo_art_8[] PROGMEM = "  \\$$$$$$   \\$$$$$$  \\$$  \\$$  \\$$ \\$$$$$$$   \\$$$$$$  \\$$";
+static const char* const ASCII_ART_COMBO[COMBO_ART_ROWS] PROGMEM = {
+	combo_art_0, combo_art_1, combo_art_2, combo_art_3, combo_art_4,
+	combo_art_5, combo_art_6, combo_art_7, combo_art_8};
 
 /* digits_displayed - 1 if digits are displayed on the seven
 ** segment display, 0 if not. No digits displayed initially.
@@ -64,6 +84,21 @@ volatile uint8_t digits_displayed = 0;
 */
 volatile uint8_t seven_seg_cc = 0;
 
+/* Countdown shown before each game (3, 2, 1, GO) - see sprite.h for the
+** format. These are drawn with their left column at x = 4.
+*/
+static const uint8_t countdown_three[] PROGMEM = {7, 1,
+	COLOUR_RED, 0x3C, 0x66, 0x60, 0x1C, 0x60, 0x66, 0x3C};
+static const uint8_t countdown_two[] PROGMEM = {7, 1,
+	COLOUR_RED, 0x3C, 0x66, 0x60, 0x1C, 0x0C, 0x06, 0x7E};
+static const uint8_t countdown_one[] PROGMEM = {7, 1,
+	COLOUR_RED, 0x18, 0x1C, 0x18, 0x18, 0x18, 0x18, 0x3C};
+static const uint8_t countdown_go[] PROGMEM = {6, 1,
+	COLOUR_GREEN, 0x00, 0xE6, 0xA1, 0xA5, 0xA5, 0xE6};
+#define COUNTDOWN_LENGTH 4
+static const uint8_t* const countdown_sprites[COUNTDOWN_LENGTH] PROGMEM = {
+	countdown_three, countdown_two, countdown_one, countdown_go};
+
 /* Seven segment display segment values for 0 to 9 and - */
 uint8_t seven_seg_data[10] = {63,6,91,79,102,109,125,7,127,111};
 	
@@ -145,7 +180,7 @@ int main(void)
 void initialise_hardware(void)
 {
 	ledmatrix_setup();
-	init_button_interrupts();
+	init_buttons();
 	// Setup serial port for 19200 baud communication with no echo
 	// of incoming characters
 	init_serial_stdio(19200, 0);
@@ -205,7 +240,7 @@ void start_screen(void)
 	}
 	
 	move_terminal_cursor(10,20);
-	printf_P(PSTR("Selected Track: Through the Fire and Flames"));
+	print_selected_track();
 	
 	digits_displayed = 0;
 	
@@ -218,19 +253,57 @@ void start_screen(void)
 	
 	uint8_t frame_number = 0;
 	
+	// Whether a chart is being uploaded (see chart_store.h). While it is,
+	// the serial input is the chart rather than key presses.
+	bool uploading = false;
 
 	// Wait until a button is pressed, or 's' is pressed on the terminal
 	while(1)
 	{
+		if (uploading)
+		{
+			uint8_t upload_result = chart_upload_poll();
+			if (upload_result != CHART_UPLOAD_BUSY)
+			{
+				uploading = false;
+				move_terminal_cursor(10,22);
+				clear_to_end_of_line();
+				if (upload_result == CHART_UPLOAD_DONE)
+				{
+					printf_P(PSTR("Chart uploaded - press 't' to select it"));
+				}
+				else
+				{
+					printf_P(PSTR("Chart upload failed"));
+				}
+				if (!track_available(track_choice))
+				{
+					// The selected chart was lost
+					track_choice = 0;
+					move_terminal_cursor(10,20);
+					print_selected_track();
+				}
+			}
+		}
+		
 		// First check for if a 's' is pressed
 		// There are two steps to this
 		// 1) collect any serial input (if available)
 		// 2) check if the input is equal to the character 's'
 		char serial_input = -1;
-		if (serial_input_available())
+		if (!uploading && serial_input_available())
 		{
 			serial_input = fgetc(stdin);
 		}
+		// If the serial input is 'u', wait for a chart to be uploaded
+		if (serial_input == 'u' || serial_input == 'U')
+		{
+			move_terminal_cursor(10,22);
+			clear_to_end_of_line();
+			printf_P(PSTR("Waiting for chart upload - press a button to cancel"));
+			chart_upload_start();
+			uploading = true;
+		}
 		// If the serial input is 's', then exit the start screen
 		if (serial_input == 's' || serial_input == 'S')
 		{
@@ -256,36 +329,9 @@ void start_screen(void)
 		// Selecting track
 		if (serial_input == 't' || serial_input == 'T')
 		{
-			if (track_choice < 2)
-			{
-				track_choice++;
-				move_terminal_cursor(10,20);
-				if (track_choice == 0)
-				{
-					clear_to_end_of_line();
-					printf_P(PSTR("Selected Track: Through the Fire and Flames"));
-				}
-				else if (track_choice == 1)
-				{
-					clear_to_end_of_line();
-					printf_P(PSTR("Selected Track: Twinkle Twinkle Little Star"));
-				}
-				else if (track_choice == 2)
-				{
-					clear_to_end_of_line();
-					printf_P(PSTR("Selected Track: Jingle Bells"));
-				}
-			}
-			else
-			{
-				track_choice = 0;
-				move_terminal_cursor(10,20);
-				if (track_choice == 0)
-				{
-					clear_to_end_of_line();
-					printf_P(PSTR("Selected Track: Through the Fire and Flames"));
-				}
-			}
+			track_choice = track_next(track_choice);
+			move_terminal_cursor(10,20);
+			print_selected_track();
 		}
 		
 		if (serial_input == '1' || serial_input == '!')
@@ -311,7 +357,15 @@ void start_screen(void)
 		int8_t btn = button_pushed();
 		if (btn != NO_BUTTON_PUSHED)
 		{
-			break;
+			if (!uploading)
+			{
+				break;
+			}
+			chart_upload_cancel();
+			uploading = false;
+			move_terminal_cursor(10,22);
+			clear_to_end_of_line();
+			printf_P(PSTR("Chart upload cancelled"));
 		}
 
 		// every 200 ms, update the animation
@@ -329,29 +383,12 @@ void new_game(void)
 {
 	// Clear the serial terminal
 	clear_terminal();
+	vterm_reset();
 	game_score = 0;
-	print_game_score(0);
-	
-	//Printing combo score
-	move_terminal_cursor(10, 22);
-	printf("COMBO SCORE: %2d", combo_score);
+	draw_game_status();
 	
 	move_terminal_cursor(10,24);
-	if (track_choice == 0)
-	{
-		clear_to_end_of_line();
-		printf_P(PSTR("Selected Track: Through the Fire and Flames"));
-	}
-	else if (track_choice == 1)
-	{
-		clear_to_end_of_line();
-		printf_P(PSTR("Selected Track: Twinkle Twinkle Little Star"));
-	}
-	else if (track_choice == 2)
-	{
-		clear_to_end_of_line();
-		printf_P(PSTR("Selected Track: Jingle Bells"));
-	}
+	print_selected_track();
 	
 	digits_displayed = 1;
 	
@@ -382,128 +419,18 @@ void new_game(void)
 	
 	// Implement the game CountDown over here!
 	uint32_t start_time;
-	ledmatrix_clear();
-	// Drawing 3
-	ledmatrix_update_pixel(5, 1, COLOUR_RED);
-	ledmatrix_update_pixel(5, 2, COLOUR_RED);
-	ledmatrix_update_pixel(4, 2, COLOUR_RED);
-	ledmatrix_update_pixel(4, 3, COLOUR_RED);
-	ledmatrix_update_pixel(4, 4, COLOUR_RED);
-	ledmatrix_update_pixel(4, 5, COLOUR_RED);
-	ledmatrix_update_pixel(5, 5, COLOUR_RED);
-	ledmatrix_update_pixel(5, 6, COLOUR_RED);
-	ledmatrix_update_pixel(6, 5, COLOUR_RED);
-	ledmatrix_update_pixel(6, 6, COLOUR_RED);
-	ledmatrix_update_pixel(7, 2, COLOUR_RED);
-	ledmatrix_update_pixel(7, 3, COLOUR_RED);
-	ledmatrix_update_pixel(7, 4, COLOUR_RED);
-	ledmatrix_update_pixel(8, 5, COLOUR_RED);
-	ledmatrix_update_pixel(8, 6, COLOUR_RED);
-	ledmatrix_update_pixel(9, 2, COLOUR_RED);
-	ledmatrix_update_pixel(9, 1, COLOUR_RED);
-	ledmatrix_update_pixel(9, 5, COLOUR_RED);
-	ledmatrix_update_pixel(9, 6, COLOUR_RED);
-	ledmatrix_update_pixel(10, 2, COLOUR_RED);
-	ledmatrix_update_pixel(10, 3, COLOUR_RED);
-	ledmatrix_update_pixel(10, 4, COLOUR_RED);
-	ledmatrix_update_pixel(10, 5, COLOUR_RED);
-	
-	start_time = get_current_time();
-	while (get_current_time() < start_time + game_speed)
-	{
-		;
-	}
-
-	ledmatrix_clear();
-	// Drawing 2
-	ledmatrix_update_pixel(4, 2, COLOUR_RED);
-	ledmatrix_update_pixel(4, 3, COLOUR_RED);
-	ledmatrix_update_pixel(4, 4, COLOUR_RED);
-	ledmatrix_update_pixel(4, 5, COLOUR_RED);
-	ledmatrix_update_pixel(5, 1, COLOUR_RED);
-	ledmatrix_update_pixel(5, 2, COLOUR_RED);
-	ledmatrix_update_pixel(5, 5, COLOUR_RED);
-	ledmatrix_update_pixel(5, 6, COLOUR_RED);
-	ledmatrix_update_pixel(6, 5, COLOUR_RED);
-	ledmatrix_update_pixel(6, 6, COLOUR_RED);
-	ledmatrix_update_pixel(7, 2, COLOUR_RED);
-	ledmatrix_update_pixel(7, 3, COLOUR_RED);
-	ledmatrix_update_pixel(7, 4, COLOUR_RED);
-	ledmatrix_update_pixel(8, 2, COLOUR_RED);
-	ledmatrix_update_pixel(8, 3, COLOUR_RED);
-	ledmatrix_update_pixel(9, 1, COLOUR_RED);
-	ledmatrix_update_pixel(9, 2, COLOUR_RED);
-	ledmatrix_update_pixel(10, 1, COLOUR_RED);
-	ledmatrix_update_pixel(10, 2, COLOUR_RED);
-	ledmatrix_update_pixel(10, 3, COLOUR_RED);
-	ledmatrix_update_pixel(10, 4, COLOUR_RED);
-	ledmatrix_update_pixel(10, 5, COLOUR_RED);
-	ledmatrix_update_pixel(10, 6, COLOUR_RED);
-	
-	start_time = get_current_time();
-	while (get_current_time() < start_time + game_speed)
-	{
-		;
-	}
-
-	ledmatrix_clear();
-	// Drawing 1
-	ledmatrix_update_pixel(4, 3, COLOUR_RED);
-	ledmatrix_update_pixel(4, 4, COLOUR_RED);
-	ledmatrix_update_pixel(5, 2, COLOUR_RED);
-	ledmatrix_update_pixel(5, 3, COLOUR_RED);
-	ledmatrix_update_pixel(5, 4, COLOUR_RED);
-	ledmatrix_update_pixel(6, 3, COLOUR_RED);
-	ledmatrix_update_pixel(6, 4, COLOUR_RED);
-	ledmatrix_update_pixel(7, 3, COLOUR_RED);
-	ledmatrix_update_pixel(7, 4, COLOUR_RED);
-	ledmatrix_update_pixel(8, 3, COLOUR_RED);
-	ledmatrix_update_pixel(8, 4, COLOUR_RED);
-	ledmatrix_update_pixel(9, 3, COLOUR_RED);
-	ledmatrix_update_pixel(9, 4, COLOUR_RED);
-	ledmatrix_update_pixel(10, 3, COLOUR_RED);
-	ledmatrix_update_pixel(10, 4, COLOUR_RED);
-	ledmatrix_update_pixel(10, 5, COLOUR_RED);
-	ledmatrix_update_pixel(10, 2, COLOUR_RED);
-	
-	start_time = get_current_time();
-	while (get_current_time() < start_time + game_speed)
-	{
-		;
-	}
-
-	ledmatrix_clear();
-	// Drawing GO
-	ledmatrix_update_pixel(5, 2, COLOUR_GREEN);
-	ledmatrix_update_pixel(5, 1, COLOUR_GREEN);
-	ledmatrix_update_pixel(5, 5, COLOUR_GREEN);
-	ledmatrix_update_pixel(5, 6, COLOUR_GREEN);
-	ledmatrix_update_pixel(5, 7, COLOUR_GREEN);
-	ledmatrix_update_pixel(6, 0, COLOUR_GREEN);
-	ledmatrix_update_pixel(6, 5, COLOUR_GREEN);
-	ledmatrix_update_pixel(6, 7, COLOUR_GREEN);
-	ledmatrix_update_pixel(7, 0, COLOUR_GREEN);
-	ledmatrix_update_pixel(7, 2, COLOUR_GREEN);
-	ledmatrix_update_pixel(7, 5, COLOUR_GREEN);
-	ledmatrix_update_pixel(7, 7, COLOUR_GREEN);
-	ledmatrix_update_pixel(8, 0, COLOUR_GREEN);
-	ledmatrix_update_pixel(8, 2, COLOUR_GREEN);
-	ledmatrix_update_pixel(8, 5, COLOUR_GREEN);
-	ledmatrix_update_pixel(8, 7, COLOUR_GREEN);
-	ledmatrix_update_pixel(9, 2, COLOUR_GREEN);
-	ledmatrix_update_pixel(9, 1, COLOUR_GREEN);
-	ledmatrix_update_pixel(9, 5, COLOUR_GREEN);
-	ledmatrix_update_pixel(9, 6, COLOUR_GREEN);
-	ledmatrix_update_pixel(9, 7, COLOUR_GREEN);
-
-	start_time = get_current_time();
-	while (get_current_time() < start_time + game_speed)
+	for (uint8_t i = 0; i < COUNTDOWN_LENGTH; i++)
 	{
-		;
+		ledmatrix_clear();
+		sprite_draw((const uint8_t*)pgm_read_word(&countdown_sprites[i]), 4, 0);
+		
+		start_time = get_current_time();
+		while (get_current_time() < start_time + game_speed)
+		{
+			;
+		}
 	}
-
 	ledmatrix_clear();
-
 	
 	// Initialize the game and display
 	initialise_game();
@@ -514,29 +441,33 @@ void new_game(void)
 	clear_serial_input_buffer();
 }
 
+// Return the next button pushed (and when, in push_time), or
+// NO_BUTTON_PUSHED if there isn't one. Any buttons released before it
+// end the hold notes being held in their lanes.
+int8_t next_button_push(BeatTime* push_time)
+{
+	ButtonEvent event;
+	while (button_event(&event))
+	{
+		if (event.edge == BUTTON_PRESSED)
+		{
+			*push_time = event.beat_time;
+			return event.lane;
+		}
+		// button n plays lane 3 - n
+		release_note(3 - event.lane);
+	}
+	return NO_BUTTON_PUSHED;
+}
+
 void play_game(void)
 {
 	update_audio_time();
 	
-	print_game_score(0);
-	
-	//Printing combo score
-	move_terminal_cursor(10, 22);
-	printf("COMBO SCORE: %2d", combo_score);
+	draw_game_status();
 	
 	move_terminal_cursor(10,24);
-	if (track_choice == 0)
-	{
-		printf_P(PSTR("Selected Track: Through the Fire and Flames"));
-	}
-	else if (track_choice == 1)
-	{
-		printf_P(PSTR("Selected Track: Twinkle Twinkle Little Star"));
-	}
-	else if (track_choice == 2)
-	{
-		printf_P(PSTR("Selected Track: Jingle Bells"));
-	}
+	print_selected_track();
 	
 	move_terminal_cursor(10,18);
 	if (game_speed == 1000)
@@ -552,62 +483,64 @@ void play_game(void)
 		printf_P(PSTR("Game Speed: Extreme"));
 	}
 
-	uint32_t last_advance_time, current_time;
 	int8_t btn; // The button pushed
 	
-	last_advance_time = get_current_time();
-	
-	int  counter = -1;
-	
+	// The notes move on one beat at a time, 5 beats per row of the track.
+	// The track's tempo (rows per minute) is for normal speed - fast and
+	// extreme speeds are 2 and 4 times that. The beat clock counts the
+	// beats at exactly this rate, however few milliseconds apart they are.
+	Track track;
+	track_get(track_choice, &track);
+	start_beat_clock(5UL * track.tempo * 1000 / game_speed);
+	beat_stats_reset();
 	
 	// We play the game until it's over
 	while (!is_game_over())
 	{
-		if (combo_score >= 3)
+		// Start the frame's serial output. Status and cosmetic output
+		// only use what room the output buffer has to spare, so the game
+		// never waits for the terminal.
+		serial_output_frame();
+		
+		// Bring the score and combo up to date, in case a change to them
+		// couldn't be sent when it happened
+		print_game_score(game_score);
+		print_combo_score();
+		
+		// Show the combo banner while the combo lasts. The terminal is
+		// only sent the rows which change, a little at a time.
+		for (uint8_t i = 0; i < COMBO_ART_ROWS; i++)
 		{
-			if (counter < 9)
+			const char* line = NULL;
+			if (combo_score >= 3)
 			{
-				counter++;
-				move_terminal_cursor(10,26 + counter);
-				printf(ASCII_ART_COMBO[counter]);
+				line = (const char*)pgm_read_word(&ASCII_ART_COMBO[i]);
 			}
+			vterm_set_line(VTERM_FIRST_ROW + i, line);
 		}
-		else
-		{
-			counter = -1;
-			move_terminal_cursor(10, 26);
-			clear_to_end_of_line();
-			move_terminal_cursor(10, 27);
-			clear_to_end_of_line();
-			move_terminal_cursor(10, 28);
-			clear_to_end_of_line();
-			move_terminal_cursor(10, 29);
-			clear_to_end_of_line();
-			move_terminal_cursor(10, 30);
-			clear_to_end_of_line();
-			move_terminal_cursor(10, 31);
-			clear_to_end_of_line();
-			move_terminal_cursor(10, 32);
-			clear_to_end_of_line();
-			move_terminal_cursor(10, 33);
-			clear_to_end_of_line();
-			move_terminal_cursor(10, 34);
-			clear_to_end_of_line();
-		}
+		vterm_update();
 		
+		// Keys are timed from when we read them, buttons from when they
+		// were pushed
 		char serial_input = -1;
+		BeatTime key_time;
+		BeatTime push_time;
 		if (serial_input_available())
 		{
 			serial_input = fgetc(stdin);
+			get_beat_time(&key_time);
 		}
 		
 		if (serial_input == 'p' || serial_input == 'P')
 		{
 			if (game_paused)
 			{
-				paused_duration = get_current_time() - paused_start;
-				last_advance_time += paused_duration;
-				(void)button_pushed();
+				resume_beat_clock();
+				// Ignore any buttons pushed since the paused loop last read them
+				while (next_button_push(&push_time) != NO_BUTTON_PUSHED)
+				{
+					;
+				}
 				game_paused = 0;
 				move_terminal_cursor(10, 20);
 				clear_to_end_of_line();
@@ -631,7 +564,7 @@ void play_game(void)
 			}
 			else
 			{
-				paused_start = get_current_time();
+				pause_beat_clock();
 				game_paused = 1;
 				move_terminal_cursor(10, 20);
 				printf("GAME PAUSED");
@@ -660,42 +593,60 @@ void play_game(void)
 			}
 		}
 		
-		if (!game_paused)
+		if (game_paused)
+		{
+			// Ignore the buttons pushed while paused, but not the releases
+			// - they end hold notes. The buttons are read every time
+			// around the loop so that however long the pause, none of the
+			// releases are lost.
+			while (next_button_push(&push_time) != NO_BUTTON_PUSHED)
+			{
+				;
+			}
+		}
+		else
 		{
 			// We need to check if any button has been pushed, this will be
 			// NO_BUTTON_PUSHED if no button has been pushed
 			// Checkout the function comment in `buttons.h` and the implementation
 			// in `buttons.c`.
-			btn = button_pushed();
+			btn = next_button_push(&push_time);
 			
-			if (btn == BUTTON0_PUSHED || (serial_input == 'f' || serial_input == 'F'))
+			// A key and a button may both have been pushed - each plays
+			// its own lane, timed from its own push. Only a button can be
+			// held down.
+			int8_t key_lane = -1;
+			if (serial_input == 'f' || serial_input == 'F')
 			{
-				// If button 0 play the lowest note (right lane)
-				play_note(3);
-				// turning ON audio
-				update_audio_time();
-				PORTD |= (1 << PIND4);
+				// the lowest note (right lane), as button 0
+				key_lane = 3;
 			}
-			else if (btn == BUTTON1_PUSHED || (serial_input == 'd' || serial_input == 'D'))
+			else if (serial_input == 'd' || serial_input == 'D')
 			{
-				// If button 1 play the second lowest note (right lane)
-				play_note(2);
-				// turning ON audio
-				update_audio_time();
-				PORTD |= (1 << PIND4);
+				// the second lowest note (right lane), as button 1
+				key_lane = 2;
+			}
+			else if (serial_input == 's' || serial_input == 'S')
+			{
+				// the second lowest note (left lane), as button 2
+				key_lane = 1;
 			}
-			else if (btn == BUTTON2_PUSHED || (serial_input == 's' || serial_input == 'S'))
+			else if (serial_input == 'a' || serial_input == 'A')
 			{
-				// If button 2 play the second lowest note (left lane)
-				play_note(1);
+				// the lowest note (left lane), as button 3
+				key_lane = 0;
+			}
+			if (key_lane >= 0)
+			{
+				play_note(key_lane, &key_time, false);
 				// turning ON audio
 				update_audio_time();
 				PORTD |= (1 << PIND4);
 			}
-			else if (btn == BUTTON3_PUSHED || (serial_input == 'a' || serial_input == 'A'))
+			if (btn != NO_BUTTON_PUSHED)
 			{
-				// If button 3 play the lowest note (left lane)
-				play_note(0);
+				// button n plays lane 3 - n
+				play_note(3 - btn, &push_time, true);
 				// turning ON audio
 				update_audio_time();
 				PORTD |= (1 << PIND4);
@@ -709,7 +660,7 @@ void play_game(void)
 			}
 			turn_off_audio = false;
 			
-			if ((beat - beat_count) == 5)
+			if ((beat - beat_count) == 5 && !is_long_note_being_played())
 			{
 				// turning OFF audio
 				OCR1B = 0;
@@ -717,7 +668,6 @@ void play_game(void)
 			}
 			
 			int n_pressed = 0;	
-			current_time = get_current_time();
 			if (manual_mode)
 			{
 				if (serial_input == 'n' || serial_input == 'N')
@@ -732,25 +682,43 @@ void play_game(void)
 						
 						n_pressed = 0;
 					}
-					last_advance_time = current_time;
 				}
+				// Keep the beat clock with the notes, so they carry on
+				// from here if manual mode is turned off
+				set_beat_clock(beat);
 			}
 			else
 			{
 				n_pressed = 0;
-				if (current_time >= last_advance_time + game_speed/5)
+				// Advance the notes to any beats the beat clock has counted
+				// since we last did. Each beat was due at a fixed time from
+				// the start of the game, so we can record how late it is.
+				// (The beat count is read before the time so that no beat
+				// appears to be early.)
+				uint16_t beats_due = get_beat_clock();
+				uint32_t now = get_beat_clock_time();
+				while ((int16_t)(beats_due - beat) > 0 && !is_game_over())
 				{
-					// 200ms (0.2 second) has passed since the last time we advance the
-					// notes here, so update the advance the notes
+					beat_stats_record(now - get_beat_deadline(beat + 1));
 					advance_note();
-							
-					// Update the most recent time the notes were advance
-					last_advance_time = current_time;// + paused_duration;
+					if (CATCH_UP_POLICY == CATCH_UP_BURST)
+					{
+						break;
+					}
 				}
 			}
 		}
 		
+		// End of the frame - show any changes made by advance_note() and
+		// play_note(). If the previous frame is still being sent we leave
+		// the changes until the next time around the loop.
+		if (ledmatrix_flush_complete())
+		{
+			ledmatrix_flush();
+		}
 	}
+	pause_beat_clock();
+	
 	// We get here if the game is over.
 	if (is_game_over())
 	{
@@ -766,6 +734,9 @@ void handle_game_over()
 	printf_P(PSTR("GAME OVER"));
 	move_terminal_cursor(10,16);
 	printf("Final Score: %4d", game_score);
+	move_terminal_cursor(10,17);
+	printf_P(PSTR("Perfect: %u  Great: %u  Good: %u"), judgement_count(PERFECT),
+			judgement_count(GREAT), judgement_count(GOOD));
 	move_terminal_cursor(10,18);
 	if (game_speed == 1000)
 	{
@@ -781,22 +752,19 @@ void handle_game_over()
 	}
 	
 	move_terminal_cursor(10,20);
-	if (track_choice == 0)
-	{
-		printf_P(PSTR("Selected Track: Through the Fire and Flames"));
-	}
-	else if (track_choice == 1)
-	{
-		printf_P(PSTR("Selected Track: Twinkle Twinkle Little Star"));
-	}
-	else if (track_choice == 2)
-	{
-		printf_P(PSTR("Selected Track: Jingle Bells"));
-	}
+	print_selected_track();
 	
 	move_terminal_cursor(10,22);
 	printf_P(PSTR("Press a button or 's'/'S' to start a new game"));
 	
+	move_terminal_cursor(10,24);
+	beat_stats_print();
+	move_terminal_cursor(10,25);
+	printf_P(PSTR("Button events dropped: %u"), button_events_dropped());
+	move_terminal_cursor(10,26);
+	printf_P(PSTR("Serial output deferred: status %u, cosmetic %u"),
+			serial_output_refused(SERIAL_STATUS), serial_output_refused(SERIAL_COSMETIC));
+	
 	// Do nothing until a button is pushed. Hint: 's'/'S' should also start a
 	// new game
 	while (button_pushed() == NO_BUTTON_PUSHED)
@@ -923,4 +891,12 @@ ISR(TIMER2_COMPA_vect) {
 		/* No digits displayed -  display is blank */
 		PORTC = 0;
 	}
-}
\ No newline at end of file
+}
+
+// Print the name and difficulty of the selected track at the cursor
+void print_selected_track(void)
+{
+	clear_to_end_of_line();
+	printf_P(PSTR("Selected Track: %S (%S)"), track_name(track_choice),
+			track_difficulty_name(track_choice));
+}
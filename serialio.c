@@ -12,11 +12,15 @@
  * put method will either
  * (1) if interrupts are enabled, block until there is room in it, or
  * (2) if interrupts are disabled, will discard the character.
+ * Less important output can avoid this by asking for room first - see
+ * serial_reserve_output().
  * Input is blocking - requesting input from stdin will block
  * until a character is available. If interrupts are disabled when 
  * input is sought, then this will block forever.
  * The function input_available() can be used to test whether there is
  * input available to read from stdin.
+ * In raw input mode received bytes are stored exactly as they arrive, for
+ * binary data - see serial_set_raw_input().
  *
  */
 
@@ -55,11 +59,23 @@ volatile uint8_t input_insert_pos;
 volatile uint8_t bytes_in_input_buffer;
 volatile uint8_t input_overrun;
 
+/* The number of bytes of status and cosmetic output which may still be
+ * sent in this frame, and the number of times output of each class has
+ * been refused (see serial_reserve_output()).
+ */
+static uint8_t frame_budget;
+static uint16_t output_refused[SERIAL_OUTPUT_CLASSES];
+
 /* Variable to keep track of whether incoming characters are to be echoed
  * back or not.
  */
 static int8_t do_echo;
 
+/* Variable to keep track of whether we are in raw input mode (no echo, and
+ * no conversion of carriage returns).
+ */
+static volatile int8_t raw_input;
+
 /* Function prototypes 
  */
 void init_serial_stdio(long baudrate, int8_t echo);
@@ -83,6 +99,12 @@ void init_serial_stdio(long baudrate, int8_t echo)
 	input_insert_pos = 0;
 	bytes_in_input_buffer = 0;
 	input_overrun = 0;
+	raw_input = 0;
+	frame_budget = SERIAL_FRAME_BUDGET;
+	for (uint8_t i = 0; i < SERIAL_OUTPUT_CLASSES; i++)
+	{
+		output_refused[i] = 0;
+	}
 	
 	/*
 	 * Record whether we're going to echo characters or not
@@ -131,6 +153,95 @@ void clear_serial_input_buffer(void)
 	bytes_in_input_buffer = 0;
 }
 
+void serial_set_raw_input(int8_t raw)
+{
+	raw_input = raw;
+}
+
+int8_t serial_input_overrun(void)
+{
+	uint8_t overrun = input_overrun;
+	input_overrun = 0;
+	return overrun;
+}
+
+/* Remove the oldest character from the input buffer and return it. There
+ * must be one there.
+ */
+static char remove_input_char(void)
+{
+	/*
+	 * Turn interrupts off and remove a character from the input
+	 * buffer. We reenable interrupts if they were on.
+	 * The pending character is the one which is byte_in_input_buffer
+	 * characters before the insert position (taking into account
+	 * that we may need to wrap around).
+	 */
+	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	char c;
+	if (input_insert_pos - bytes_in_input_buffer < 0)
+	{
+		/* Need to wrap around */
+		c = input_buffer[input_insert_pos - bytes_in_input_buffer
+				+ INPUT_BUFFER_SIZE];
+	} else
+	{
+		c = input_buffer[input_insert_pos - bytes_in_input_buffer];
+	}
+	
+	/* Decrement our count of bytes in the input buffer */
+	bytes_in_input_buffer--;
+	if (interrupts_enabled)
+	{
+		sei();
+	}	
+	return c;
+}
+
+int16_t serial_read_byte(void)
+{
+	if (bytes_in_input_buffer == 0)
+	{
+		return -1;
+	}
+	return (uint8_t)remove_input_char();
+}
+
+void serial_output_frame(void)
+{
+	frame_budget = SERIAL_FRAME_BUDGET;
+}
+
+int8_t serial_reserve_output(uint8_t output_class, uint8_t n)
+{
+	if (output_class == SERIAL_CRITICAL)
+	{
+		return 1;
+	}
+	
+	/* The buffer is only emptied by the interrupt handler, so the room
+	 * in it can only grow until we fill it */
+	uint8_t headroom = (output_class == SERIAL_STATUS)
+			? SERIAL_STATUS_HEADROOM : SERIAL_COSMETIC_HEADROOM;
+	uint8_t room = OUTPUT_BUFFER_SIZE - bytes_in_out_buffer;
+	if (n > frame_budget || room < headroom || room - headroom < n)
+	{
+		if (output_refused[output_class] != UINT16_MAX)
+		{
+			output_refused[output_class]++;
+		}
+		return 0;
+	}
+	frame_budget -= n;
+	return 1;
+}
+
+uint16_t serial_output_refused(uint8_t output_class)
+{
+	return output_refused[output_class];
+}
+
 static int uart_put_char(char c, FILE* stream)
 {
 	uint8_t interrupts_enabled;
@@ -197,34 +308,7 @@ int uart_get_char(FILE* stream)
 	{
 		/* do nothing */
 	}
-	
-	/*
-	 * Turn interrupts off and remove a character from the input
-	 * buffer. We reenable interrupts if they were on.
-	 * The pending character is the one which is byte_in_input_buffer
-	 * characters before the insert position (taking into account
-	 * that we may need to wrap around).
-	 */
-	uint8_t interrupts_enabled = bit_is_set(SREG, SREG_I);
-	cli();
-	char c;
-	if (input_insert_pos - bytes_in_input_buffer < 0)
-	{
-		/* Need to wrap around */
-		c = input_buffer[input_insert_pos - bytes_in_input_buffer
-				+ INPUT_BUFFER_SIZE];
-	} else
-	{
-		c = input_buffer[input_insert_pos - bytes_in_input_buffer];
-	}
-	
-	/* Decrement our count of bytes in the input buffer */
-	bytes_in_input_buffer--;
-	if (interrupts_enabled)
-	{
-		sei();
-	}	
-	return c;
+	return remove_input_char();
 }
 
 /*
@@ -283,7 +367,7 @@ ISR(USART0_RX_vect)
 	char c;
 	c = UDR0;
 		
-	if (do_echo && bytes_in_out_buffer < OUTPUT_BUFFER_SIZE)
+	if (do_echo && !raw_input && bytes_in_out_buffer < OUTPUT_BUFFER_SIZE)
 	{
 		/* If echoing is enabled and there is output buffer
 		 * space, echo the received character back to the UART.
@@ -305,9 +389,9 @@ ISR(USART0_RX_vect)
 	} else
 	{
 		/* If the character is a carriage return, turn it into a
-		 * linefeed 
+		 * linefeed (unless we're in raw input mode)
 		*/
-		if (c == '\r')
+		if (c == '\r' && !raw_input)
 		{
 			c = '\n';
 		}
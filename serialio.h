@@ -36,5 +36,61 @@ int8_t serial_input_available(void);
  */
 void clear_serial_input_buffer(void);
 
+/* Turn raw input mode on (non-zero) or off (zero). In raw input mode
+ * received bytes are kept exactly as they arrive - carriage returns are
+ * not turned into linefeeds and nothing is echoed - so binary data can be
+ * received. Raw bytes should be read with serial_read_byte().
+ */
+void serial_set_raw_input(int8_t raw);
+
+/* Return the next byte received (0 to 255) without waiting, or -1 if no
+ * input is available.
+ */
+int16_t serial_read_byte(void);
+
+/* Return non-zero if input has been lost because the input buffer was
+ * full (since this function was last called), zero otherwise.
+ */
+int8_t serial_input_overrun(void);
+
+/* Output classes. Output is normally critical - it is always sent, and
+ * if the output buffer is full the sender waits for room (as described
+ * above). Status output (e.g. the score) and cosmetic output (e.g.
+ * decorations) should only be sent once serial_reserve_output() has
+ * agreed to it, so that they never wait and never take the room that
+ * more important output needs. Each frame (e.g. each time around the
+ * game loop, marked by calling serial_output_frame()) they may use up
+ * to SERIAL_FRAME_BUDGET bytes between them, and only while the output
+ * buffer has room to spare: status output leaves SERIAL_STATUS_HEADROOM
+ * bytes free for critical output, and cosmetic output leaves
+ * SERIAL_COSMETIC_HEADROOM bytes free for both.
+ */
+#define SERIAL_CRITICAL 0
+#define SERIAL_STATUS 1
+#define SERIAL_COSMETIC 2
+#define SERIAL_OUTPUT_CLASSES 3
+
+#define SERIAL_FRAME_BUDGET 96
+#define SERIAL_STATUS_HEADROOM 32
+#define SERIAL_COSMETIC_HEADROOM 128
+
+/* Start a new frame, renewing the budget for status and cosmetic output.
+ */
+void serial_output_frame(void);
+
+/* Return non-zero if n bytes of output of the given class can be sent
+ * now, in which case they are taken from the frame's budget and can be
+ * printed without waiting. If zero is returned the output should be
+ * left out, or kept and tried again later (so that only the latest of
+ * several changes is sent) - the refusal is counted.
+ * (Critical output is always agreed to.)
+ */
+int8_t serial_reserve_output(uint8_t output_class, uint8_t n);
+
+/* Return the number of times output of the given class has been refused
+ * by serial_reserve_output().
+ */
+uint16_t serial_output_refused(uint8_t output_class);
+
 
 #endif /* SERIALIO_H_ */
@@ -6,6 +6,49 @@
 
 #include "spi.h"
 #include <avr/io.h>
+#include <avr/interrupt.h>
+
+// Circular buffer of bytes waiting to be sent. Bytes are added at
+// queue_head and removed at queue_tail by the SPI interrupt handler
+// once the previous byte has been shifted out. SPI_QUEUE_SIZE must be
+// a power of two (no larger than 128) so we can wrap with a mask.
+// spi_busy is set while a byte is being shifted out.
+#define SPI_QUEUE_SIZE 128
+#define SPI_QUEUE_MASK (SPI_QUEUE_SIZE - 1)
+static volatile uint8_t spi_queue[SPI_QUEUE_SIZE];
+static volatile uint8_t queue_head;
+static volatile uint8_t queue_tail;
+static volatile uint8_t queue_length;
+static volatile uint8_t spi_busy;
+static volatile uint8_t last_received;
+
+// Called when a byte transfer has completed (either from the interrupt
+// handler or by polling when interrupts are off). Start sending the
+// next byte in the queue, if any.
+static void transmit_next_byte(void)
+{
+	last_received = SPDR0;
+	if (queue_length > 0)
+	{
+		SPDR0 = spi_queue[queue_tail];
+		queue_tail = (queue_tail + 1) & SPI_QUEUE_MASK;
+		queue_length--;
+	}
+	else
+	{
+		spi_busy = 0;
+	}
+}
+
+// If interrupts are disabled the interrupt handler can't empty the queue,
+// so we check the transfer complete flag ourselves.
+static void poll_transfer_complete(void)
+{
+	if (SPSR0 & (1 << SPIF0))
+	{
+		transmit_next_byte();
+	}
+}
 
 void spi_setup_master(uint8_t clockdivider)
 {
@@ -20,7 +63,8 @@ void spi_setup_master(uint8_t clockdivider)
 	// Set up the SPI control registers SPCR and SPSR:
 	// - SPE bit = 1 (SPI is enabled)
 	// - MSTR bit = 1 (Master Mode)
-	SPCR0 = (1 << SPE0) | (1 << MSTR0);
+	// - SPIE bit = 1 (interrupt when each transfer is complete)
+	SPCR0 = (1 << SPE0) | (1 << MSTR0) | (1 << SPIE0);
 	
 	// Set SPR0 and SPR1 bits in SPCR and SPI2X bit in SPSR
 	// based on the given clock divider
@@ -54,20 +98,85 @@ void spi_setup_master(uint8_t clockdivider)
 	
 	// Take SS (slave select) line low
 	PORTB &= ~(1 << PORTB4);
+	
+	// Empty the transmit queue
+	queue_head = 0;
+	queue_tail = 0;
+	queue_length = 0;
+	spi_busy = 0;
 }
 
 uint8_t spi_send_byte(uint8_t byte)
 {
-	// Write out the byte to the SPDR0 register. This will initiate
-	// the transfer. We then wait until the most significant byte of
-	// SPSR0 (SPIF0 bit) is set - this indicates that the transfer is
-	// complete. (The final read of SPSR0 followed by a read of SPDR0
-	// will cause the SPIF bit to be reset to 0. See page 173 of the 
-	// ATmega324A datasheet.)
-	SPDR0 = byte;
-	while ((SPSR0 & (1 << SPIF0)) == 0)
+	// Queue the byte and wait until it (and anything queued before it)
+	// has been sent. The interrupt handler saves the byte received from
+	// SPDR0 as each transfer completes - see page 173 of the ATmega324A
+	// datasheet.
+	spi_queue_byte(byte);
+	spi_wait_until_idle();
+	return last_received;
+}
+
+void spi_queue_byte(uint8_t byte)
+{
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	
+	// Wait until there is room in the queue. The queue_length variable
+	// will get modified by the interrupt handler as bytes are sent.
+	while (queue_length >= SPI_QUEUE_SIZE)
 	{
-		; // wait
+		if (!interrupts_were_enabled)
+		{
+			poll_transfer_complete();
+		}
 	}
-	return SPDR0;
+	
+	// If nothing is being sent we can start this byte straight away,
+	// otherwise add it to the queue. Interrupts are turned off while we
+	// change the queue so the interrupt handler doesn't change it at the
+	// same time.
+	cli();
+	if (!spi_busy)
+	{
+		spi_busy = 1;
+		SPDR0 = byte;
+	}
+	else
+	{
+		spi_queue[queue_head] = byte;
+		queue_head = (queue_head + 1) & SPI_QUEUE_MASK;
+		queue_length++;
+	}
+	if (interrupts_were_enabled)
+	{
+		sei();
+	}
+}
+
+uint8_t spi_queue_length(void)
+{
+	return queue_length;
+}
+
+uint8_t spi_is_idle(void)
+{
+	return !spi_busy;
+}
+
+void spi_wait_until_idle(void)
+{
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	while (spi_busy)
+	{
+		if (!interrupts_were_enabled)
+		{
+			poll_transfer_complete();
+		}
+	}
+}
+
+// Interrupt handler for SPI transfer complete. Send the next queued byte.
+ISR(SPI_STC_vect)
+{
+	transmit_next_byte();
 }
@@ -14,7 +14,24 @@
 void spi_setup_master(uint8_t clockdivider);
 
 // Send and receive an SPI byte. This function will take at least 8 
-// cyles of the divided clock (i.e. will busy wait).
+// cyles of the divided clock (i.e. will busy wait) after any queued
+// bytes have been sent.
 uint8_t spi_send_byte(uint8_t byte);
 
+// Add a byte to the transmit queue and return immediately. Queued bytes
+// are sent in order by the SPI interrupt handler. If the queue is full
+// this will wait until there is room. (If interrupts are disabled, the
+// queue is emptied by polling instead.)
+void spi_queue_byte(uint8_t byte);
+
+// Return the number of bytes waiting to be sent (not including any byte
+// currently being shifted out).
+uint8_t spi_queue_length(void);
+
+// Return non-zero if no bytes are queued or being sent.
+uint8_t spi_is_idle(void);
+
+// Wait until all queued bytes have been sent.
+void spi_wait_until_idle(void);
+
 #endif /* SPI_H_ */
@@ -0,0 +1,39 @@
+/*
+ * sprite.c
+ *
+ * Draw sprites stored in flash on the LED matrix. See sprite.h for the
+ * sprite format.
+ */
+
+#include "sprite.h"
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "ledmatrix.h"
+
+void sprite_draw(const uint8_t* sprite, uint8_t x, uint8_t y)
+{
+	uint8_t width = pgm_read_byte(&sprite[0]);
+	uint8_t num_layers = pgm_read_byte(&sprite[1]);
+	
+	// Draw each layer into the LED matrix's copy of the display, then
+	// send the changes. Layer n starts (width + 1) * n bytes after the
+	// first layer.
+	const uint8_t* layer = &sprite[2];
+	for (uint8_t n = 0; n < num_layers; n++)
+	{
+		PixelColour colour = pgm_read_byte(&layer[0]);
+		for (uint8_t col = 0; col < width && x + col < MATRIX_NUM_COLUMNS; col++)
+		{
+			uint8_t col_data = pgm_read_byte(&layer[1 + col]);
+			for (uint8_t row = y; row < MATRIX_NUM_ROWS; row++)
+			{
+				if (col_data >> (row - y) & 1)
+				{
+					ledmatrix_draw_pixel(x + col, row, colour);
+				}
+			}
+		}
+		layer += width + 1;
+	}
+	ledmatrix_flush();
+}
@@ -0,0 +1,29 @@
+/*
+ * sprite.h
+ *
+ * Small pictures (digits, logos etc.) stored in flash and drawn on the
+ * LED matrix.
+ *
+ * A sprite is an array of bytes stored in program memory (PROGMEM),
+ * packed column by column:
+ *   width (number of columns), number of layers,
+ *   then for each layer: the layer's colour, followed by width bytes -
+ *   one per column - where bit y is set if the pixel in row y of that
+ *   column is to be drawn in the layer's colour.
+ * Later layers are drawn over earlier ones. Pixels which aren't set in
+ * any layer are transparent (left unchanged).
+ */
+
+#ifndef SPRITE_H_
+#define SPRITE_H_
+
+#include <stdint.h>
+
+// Draw the sprite with its left column at x and its bottom row at y.
+// The changes are sent with ledmatrix_flush(), so each column the sprite
+// covers costs at most one column update (and columns with only a few
+// changed pixels cost less). Parts of the sprite which fall off the display
+// are ignored.
+void sprite_draw(const uint8_t* sprite, uint8_t x, uint8_t y);
+
+#endif /* SPRITE_H_ */
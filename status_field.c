@@ -0,0 +1,93 @@
+/*
+ * status_field.c
+ *
+ * Numbers shown on the serial terminal which change often - see
+ * status_field.h.
+ */
+
+#include "status_field.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "serialio.h"
+
+// Write value into text (width characters), right-aligned and padded
+// with spaces.
+static void format_value(char* text, uint8_t width, int16_t value)
+{
+	uint16_t magnitude = (value < 0) ? -(uint16_t)value : (uint16_t)value;
+	int8_t i = width - 1;
+	do
+	{
+		text[i--] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while (magnitude && i >= 0);
+	if (value < 0 && i >= 0)
+	{
+		text[i--] = '-';
+	}
+	while (i >= 0)
+	{
+		text[i--] = ' ';
+	}
+}
+
+void status_field_draw(StatusField* field, int16_t value)
+{
+	format_value(field->shown, field->width, value);
+	fputs_P(field->label, stdout);
+	for (uint8_t i = 0; i < field->width; i++)
+	{
+		putchar(field->shown[i]);
+	}
+}
+
+void status_field_update(StatusField* field, int16_t value)
+{
+	char text[STATUS_FIELD_MAX_WIDTH];
+	format_value(text, field->width, value);
+	
+	// Find the first and last characters which have changed
+	int8_t last = field->width - 1;
+	while (last >= 0 && text[last] == field->shown[last])
+	{
+		last--;
+	}
+	if (last < 0)
+	{
+		return;
+	}
+	int8_t first = 0;
+	while (text[first] == field->shown[first])
+	{
+		first++;
+	}
+	
+	// Move to the first change and send the value up to the last. If
+	// there isn't room to send it now, the field is left as it is and the
+	// latest value is sent by a later update.
+	uint8_t column = field->column + first;
+	uint8_t column_digits = (column >= 100) ? 3 : (column >= 10) ? 2 : 1;
+	if (!serial_reserve_output(SERIAL_STATUS, strlen_P(field->row)
+			+ column_digits + 1 + (last - first + 1)))
+	{
+		return;
+	}
+	fputs_P(field->row, stdout);
+	if (column >= 100)
+	{
+		putchar('0' + column / 100);
+	}
+	if (column >= 10)
+	{
+		putchar('0' + column / 10 % 10);
+	}
+	putchar('0' + column % 10);
+	putchar('H');
+	for (int8_t i = first; i <= last; i++)
+	{
+		putchar(text[i]);
+		field->shown[i] = text[i];
+	}
+}
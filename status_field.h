@@ -0,0 +1,47 @@
+/*
+ * status_field.h
+ *
+ * Numbers shown on the serial terminal which change often, such as the
+ * score. A status field is drawn once with its label, and after that
+ * only the characters of its value from the first to the last which have
+ * changed are sent - a cursor movement (mostly kept in flash) and a few
+ * digits. No printf() formatting is done, so updating a field is quick
+ * and uses little stack.
+ */
+
+#ifndef STATUS_FIELD_H_
+#define STATUS_FIELD_H_
+
+#include <stdint.h>
+
+#define STATUS_FIELD_MAX_WIDTH 6	// enough for -32768
+
+// A status field. label and row are strings in program memory: label
+// moves the cursor to where the field starts and prints its label, and
+// row is the start of a cursor movement to the field's row (e.g.
+// "\x1b[14;"), which is finished with the column of the character to be
+// sent. The value starts at column, and is printed right-aligned in width
+// characters (padded with spaces). A value too wide for the field loses
+// its leftmost digits.
+typedef struct
+{
+	const char* label;
+	const char* row;
+	uint8_t column;
+	uint8_t width;
+	char shown[STATUS_FIELD_MAX_WIDTH];	// the value as it was last sent
+} StatusField;
+
+// Draw the field's label and value (e.g. after the terminal is cleared).
+void status_field_draw(StatusField* field, int16_t value);
+
+// Show a new value in a field that has been drawn, sending only the
+// characters from the first to the last which have changed (nothing, if
+// none have).
+// This is status output (see serialio.h) - if there isn't room for it,
+// nothing is sent and the field is brought up to date by a later call,
+// so a field should be updated regularly (e.g. every frame). Drawing a
+// field is critical output.
+void status_field_update(StatusField* field, int16_t value);
+
+#endif /* STATUS_FIELD_H_ */
@@ -7,6 +7,7 @@
 #include "terminalio.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <avr/pgmspace.h>
 
 
@@ -15,6 +16,79 @@ void move_terminal_cursor(int x, int y)
     printf_P(PSTR("\x1b[%d;%dH"), y, x);
 }
 
+// Number of characters in the decimal form of n (n > 0)
+static uint8_t decimal_length(int n)
+{
+	return (n >= 100) ? 3 : (n >= 10) ? 2 : 1;
+}
+
+// Number of characters in an escape sequence moving the cursor n places
+// in one direction ("\x1b[nA" etc.) - none if n is 0, and the count is
+// left out if it is 1
+static uint8_t step_length(int n)
+{
+	if (n == 0)
+	{
+		return 0;
+	}
+	return (n == 1) ? 3 : 3 + decimal_length(n);
+}
+
+// Move the cursor n places in the direction given by the final character
+// of the escape sequence (A up, B down, C right, D left)
+static void step_cursor(int n, char direction)
+{
+	if (n == 1)
+	{
+		printf_P(PSTR("\x1b[%c"), direction);
+	}
+	else if (n > 1)
+	{
+		printf_P(PSTR("\x1b[%d%c"), n, direction);
+	}
+}
+
+uint8_t move_terminal_cursor_from(int from_x, int from_y, int x, int y)
+{
+	int dx = x - from_x;
+	int dy = y - from_y;
+	uint8_t vertical = step_length(abs(dy));
+	
+	// Move straight there, e.g. "\x1b[12;10H" ("\x1b[12H" for column 1)
+	uint8_t absolute = (x == 1) ? 3 + decimal_length(y)
+			: 4 + decimal_length(y) + decimal_length(x);
+	// Move up/down and left/right
+	uint8_t relative = vertical + step_length(abs(dx));
+	// Return to the first column, then move up/down and right
+	uint8_t from_left = 1 + vertical + step_length(x - 1);
+	
+	if (dx == 0 && dy == 0)
+	{
+		return 0;
+	}
+	if (absolute <= relative && absolute <= from_left)
+	{
+		if (x == 1)
+		{
+			printf_P(PSTR("\x1b[%dH"), y);
+		}
+		else
+		{
+			move_terminal_cursor(x, y);
+		}
+		return absolute;
+	}
+	step_cursor(abs(dy), (dy < 0) ? 'A' : 'B');
+	if (relative <= from_left)
+	{
+		step_cursor(abs(dx), (dx < 0) ? 'D' : 'C');
+		return relative;
+	}
+	putchar('\r');
+	step_cursor(x - 1, 'C');
+	return from_left;
+}
+
 void normal_display_mode(void)
 {
 	printf_P(PSTR("\x1b[0m"));
@@ -56,6 +56,11 @@ typedef enum
 } DisplayParameter;
 
 void move_terminal_cursor(int x, int y);
+
+// Move the cursor from (from_x, from_y) to (x, y) using whichever
+// escape sequence (or carriage return and escape sequences) is shortest.
+// Returns the number of characters sent.
+uint8_t move_terminal_cursor_from(int from_x, int from_y, int x, int y);
 void normal_display_mode(void);
 void reverse_video(void);
 void clear_terminal(void);
@@ -6,16 +6,36 @@
  * We setup timer0 to generate an interrupt every 1ms
  * We update a global clock tick variable - whose value
  * can be retrieved using the get_clock_ticks() function.
+ * We also keep the beat clock (see timer0.h) here, and sample
+ * the buttons (see buttons.h).
  */
 
 #include "timer0.h"
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include "buttons.h"
 
 /* Our internal clock tick count - incremented every 
  * millisecond. Will overflow every ~49 days. */
 static volatile uint32_t clock_ticks_ms;
 
+/* The beat clock. While it is running, beat_clock_rate (beats per
+ * minute) is added to beat_clock_fraction every millisecond, and each
+ * time the fraction reaches 60000 (the number of milliseconds in a
+ * minute) a beat is counted and 60000 is taken off. The beats therefore
+ * come at exactly beat_clock_rate per minute on average, for any rate,
+ * and no rounding error builds up - each beat is at most 1ms from where
+ * it should be. beat_clock_ms counts the milliseconds the clock has run
+ * since the count was last set (to beat_clock_origin), which gives the
+ * exact time each beat was due. */
+#define MS_PER_MINUTE 60000UL
+static volatile uint16_t beat_clock_count;
+static volatile uint16_t beat_clock_origin;
+static volatile uint32_t beat_clock_ms;
+static volatile uint32_t beat_clock_fraction;
+static volatile uint16_t beat_clock_rate;
+static volatile uint8_t beat_clock_running;
+
 /* Set up timer 0 to generate an interrupt every 1ms. 
  * We will divide the clock by 64 and count up to 124.
  * We will therefore get an interrupt every 64 x 125
@@ -30,6 +50,7 @@ void init_timer0(void)
 	 * constant. 
 	 */
 	clock_ticks_ms = 0L;
+	beat_clock_running = 0;
 	
 	/* Clear the timer */
 	TCNT0 = 0;
@@ -75,8 +96,149 @@ uint32_t get_current_time(void)
 	return return_value;
 }
 
+void start_beat_clock(uint16_t beats_per_minute)
+{
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	beat_clock_rate = beats_per_minute;
+	beat_clock_count = 0;
+	beat_clock_origin = 0;
+	beat_clock_ms = 0;
+	beat_clock_fraction = 0;
+	beat_clock_running = 1;
+	if (interrupts_were_enabled)
+	{
+		sei();
+	}
+}
+
+void set_beat_clock(uint16_t beats)
+{
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	beat_clock_count = beats;
+	beat_clock_origin = beats;
+	beat_clock_ms = 0;
+	beat_clock_fraction = 0;
+	if (interrupts_were_enabled)
+	{
+		sei();
+	}
+}
+
+void pause_beat_clock(void)
+{
+	beat_clock_running = 0;
+}
+
+void resume_beat_clock(void)
+{
+	beat_clock_running = 1;
+}
+
+uint16_t get_beat_clock(void)
+{
+	uint16_t return_value;
+	
+	/* As for get_current_time() */
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	return_value = beat_clock_count;
+	if (interrupts_were_enabled)
+	{
+		sei();
+	}
+	return return_value;
+}
+
+uint32_t get_beat_clock_time(void)
+{
+	uint32_t return_value;
+	
+	/* As for get_current_time() */
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	return_value = beat_clock_ms;
+	if (interrupts_were_enabled)
+	{
+		sei();
+	}
+	return return_value;
+}
+
+uint32_t get_beat_deadline(uint16_t beat)
+{
+	/* The beat is counted in the first millisecond at which
+	 * ms * rate >= (beat - origin) * 60000 */
+	uint32_t beats = (uint16_t)(beat - beat_clock_origin);
+	if (beat_clock_rate == 0)
+	{
+		return UINT32_MAX;
+	}
+	return (beats * MS_PER_MINUTE + beat_clock_rate - 1) / beat_clock_rate;
+}
+
+void get_beat_time(BeatTime* time)
+{
+	/* As for get_current_time() */
+	uint8_t interrupts_were_enabled = bit_is_set(SREG, SREG_I);
+	cli();
+	uint16_t beats = beat_clock_count;
+	uint32_t fraction = beat_clock_fraction;
+	if (beat_clock_running)
+	{
+		/* Add the part of the current millisecond that has gone - the
+		 * timer counts 125 steps per millisecond. If the timer has just
+		 * reached its compare value but the interrupt hasn't run yet, the
+		 * whole millisecond has gone. */
+		uint8_t steps = TCNT0;
+		if (TIFR0 & (1 << OCF0A))
+		{
+			steps = 125;
+		}
+		fraction += (uint32_t)beat_clock_rate * steps / 125;
+		while (fraction >= MS_PER_MINUTE)
+		{
+			fraction -= MS_PER_MINUTE;
+			beats++;
+		}
+	}
+	if (interrupts_were_enabled)
+	{
+		sei();
+	}
+	time->beats = beats;
+	time->fraction = fraction;
+}
+
+int32_t beat_fractions_to_us(int32_t fractions)
+{
+	/* A fraction is 1/60000 of a beat and the clock counts beat_clock_rate
+	 * fractions per millisecond */
+	if (beat_clock_rate == 0)
+	{
+		return 0;
+	}
+	return fractions * 1000 / (int32_t)beat_clock_rate;
+}
+
 ISR(TIMER0_COMPA_vect)
 {
 	/* Increment our clock tick count */
 	clock_ticks_ms++;
+	
+	/* Advance the beat clock */
+	if (beat_clock_running)
+	{
+		beat_clock_ms++;
+		beat_clock_fraction += beat_clock_rate;
+		while (beat_clock_fraction >= MS_PER_MINUTE)
+		{
+			beat_clock_fraction -= MS_PER_MINUTE;
+			beat_clock_count++;
+		}
+	}
+	
+	/* Sample the buttons */
+	debounce_buttons();
 }
@@ -30,4 +30,47 @@ void init_timer0(void);
  */
 uint32_t get_current_time(void);
 
+/* The beat clock counts beats at a given tempo (beats per minute - any
+ * value, not just those whose beats are a whole number of milliseconds
+ * apart). Over any length of time the count is exact to within one beat,
+ * so a song played with it doesn't drift. 
+ * start_beat_clock() sets the count to 0 and starts the clock at the
+ * given tempo, set_beat_clock() changes the count (without changing
+ * whether the clock is running), and pause_beat_clock() and
+ * resume_beat_clock() stop and restart it.
+ */
+void start_beat_clock(uint16_t beats_per_minute);
+void set_beat_clock(uint16_t beats);
+void pause_beat_clock(void);
+void resume_beat_clock(void);
+
+/* Return the number of beats counted by the beat clock.
+ */
+uint16_t get_beat_clock(void);
+
+/* Return the time (ms) the beat clock has been running since it was last
+ * started or set, and the time at which it counted (or will count) the
+ * given beat. The difference is how late the beat is being dealt with.
+ * The beat must not be before the one the clock was last set to.
+ */
+uint32_t get_beat_clock_time(void);
+uint32_t get_beat_deadline(uint16_t beat);
+
+/* A point in time measured by the beat clock: a number of beats and a
+ * fraction of the next beat, in 60000ths (BEAT_FRACTIONS) of a beat.
+ * get_beat_time() reads it to a resolution of 8us (a count of the timer
+ * itself), so it can be called e.g. from an interrupt handler to note
+ * when something happened. beat_fractions_to_us() converts a number of
+ * fractions of a beat to microseconds at the clock's tempo.
+ */
+#define BEAT_FRACTIONS 60000L
+typedef struct
+{
+	uint16_t beats;
+	uint16_t fraction;
+} BeatTime;
+
+void get_beat_time(BeatTime* time);
+int32_t beat_fractions_to_us(int32_t fractions);
+
 #endif /* TIMER0_H_ */
@@ -0,0 +1,248 @@
+/*
+ * chart_board_stub.c
+ *
+ * Stand-in for the board's end of a chart upload (chart_store.c), for
+ * testing chart_upload without a board. It creates a pseudo terminal,
+ * prints its name, and then receives a chart through it with the same
+ * protocol code as the board, storing it in a pretend 1 KB EEPROM. Once
+ * the upload is complete the chart is decoded and printed, one row per
+ * line, in the format chart_upload reads - so it can be compared with
+ * the file which was uploaded.
+ *
+ * Errors can be injected to test the retries: -c N damages every Nth
+ * byte received, and -d N drops every Nth reply.
+ *
+ * For example:
+ *   gcc -std=gnu99 -I.. -o chart_board_stub chart_board_stub.c \
+ *       ../chart_protocol.c
+ *   ./chart_board_stub -c 50 -d 7 > received.txt &
+ *   ./chart_upload /dev/pts/N chart.txt
+ *
+ * This file is not part of the AVR build.
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include "chart_protocol.h"
+
+// The same layout as chart_store.c
+#define EEPROM_SIZE		1024
+#define LENGTH_ADDRESS	1
+#define SIZE_ADDRESS	3
+#define DATA_ADDRESS	8
+#define CAPACITY		(EEPROM_SIZE - DATA_ADDRESS)
+
+// Give up if nothing arrives for this long (ms)
+#define IDLE_TIMEOUT	10000
+
+// As in chart_store.c, a partly received or damaged frame is NAKed once
+// nothing more has arrived for this long (ms)
+#define FRAME_TIMEOUT	200
+
+// And once the chart is stored, a repeated end frame is ACKed until
+// nothing has arrived for this long (ms)
+#define END_TIMEOUT		1500
+
+static uint8_t eeprom[EEPROM_SIZE];
+static int corrupt_every = 0;
+static int drop_every = 0;
+static long bytes_seen = 0;
+static long replies_made = 0;
+
+static void usage(const char* program)
+{
+	fprintf(stderr, "Usage: %s [-c N] [-d N]\n"
+			"  -c N  damage every Nth byte received\n"
+			"  -d N  drop every Nth reply\n",
+			program);
+	exit(2);
+}
+
+static void reply(int fd, uint8_t byte)
+{
+	replies_made++;
+	if (drop_every && replies_made % drop_every == 0)
+	{
+		fprintf(stderr, "stub: dropping reply 0x%02X\n", byte);
+		return;
+	}
+	if (write(fd, &byte, 1) != 1)
+	{
+		perror("write");
+		exit(1);
+	}
+}
+
+static void print_chart(void)
+{
+	uint16_t length = eeprom[LENGTH_ADDRESS] | (eeprom[LENGTH_ADDRESS + 1] << 8);
+	uint16_t size = eeprom[SIZE_ADDRESS] | (eeprom[SIZE_ADDRESS + 1] << 8);
+	uint16_t rows = 0;
+	for (uint16_t i = DATA_ADDRESS; i < DATA_ADDRESS + size; i++)
+	{
+		if (eeprom[i])
+		{
+			printf("0x%02X\n", eeprom[i]);
+			rows++;
+		}
+		else
+		{
+			uint8_t run = eeprom[++i];
+			for (uint8_t j = 0; j < run; j++)
+			{
+				printf("0x00\n");
+			}
+			rows += run;
+		}
+	}
+	fprintf(stderr, "stub: received %u rows (header says %u) in %u bytes\n",
+			rows, length, size);
+}
+
+int main(int argc, char* argv[])
+{
+	int option;
+	while ((option = getopt(argc, argv, "c:d:")) != -1)
+	{
+		switch (option)
+		{
+			case 'c':
+				corrupt_every = atoi(optarg);
+				break;
+			case 'd':
+				drop_every = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	
+	int fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0)
+	{
+		perror("pseudo terminal");
+		return 1;
+	}
+	// Keep the other end open (and raw) so that reads don't fail
+	// between uploads
+	int other_end = open(ptsname(fd), O_RDWR | O_NOCTTY);
+	struct termios settings;
+	if (other_end >= 0 && tcgetattr(other_end, &settings) == 0)
+	{
+		cfmakeraw(&settings);
+		tcsetattr(other_end, TCSANOW, &settings);
+	}
+	fprintf(stderr, "stub: board on %s\n", ptsname(fd));
+	
+	ChartReceiver receiver;
+	chart_receiver_reset(&receiver);
+	uint16_t chart_size = 0;
+	uint16_t bytes_received = 0;
+	uint8_t stored = 0;
+	struct pollfd waiting = {fd, POLLIN, 0};
+	
+	while (1)
+	{
+		uint8_t in_frame = chart_receiver_in_frame(&receiver);
+		int timeout = in_frame ? FRAME_TIMEOUT
+				: stored ? END_TIMEOUT : IDLE_TIMEOUT;
+		if (poll(&waiting, 1, timeout) <= 0)
+		{
+			if (stored && !in_frame)
+			{
+				print_chart();
+				return 0;
+			}
+			if (in_frame)
+			{
+				chart_receiver_resync(&receiver);
+				reply(fd, CHART_NAK);
+				continue;
+			}
+			fprintf(stderr, "stub: timed out\n");
+			return 1;
+		}
+		uint8_t byte;
+		if (read(fd, &byte, 1) != 1)
+		{
+			continue;
+		}
+		bytes_seen++;
+		if (corrupt_every && bytes_seen % corrupt_every == 0)
+		{
+			byte ^= 0x5A;
+		}
+		
+		uint8_t result = chart_receiver_feed(&receiver, byte);
+		if (stored)
+		{
+			// Only a repeated end frame is expected
+			if (result == CHART_RX_REPEAT)
+			{
+				reply(fd, CHART_ACK);
+			}
+			continue;
+		}
+		switch (result)
+		{
+			case CHART_RX_FRAME:
+				if (receiver.sequence == 0 && bytes_received == 0)
+				{
+					if (receiver.length != CHART_HEADER_LENGTH)
+					{
+						reply(fd, CHART_CAN);
+						return 1;
+					}
+					chart_size = receiver.payload[2] | (receiver.payload[3] << 8);
+					if (chart_size > CAPACITY)
+					{
+						fprintf(stderr, "stub: chart too big (%u bytes)\n",
+								chart_size);
+						reply(fd, CHART_CAN);
+						return 1;
+					}
+					for (uint8_t i = 0; i < CHART_HEADER_LENGTH; i++)
+					{
+						eeprom[LENGTH_ADDRESS + i] = receiver.payload[i];
+					}
+				}
+				else
+				{
+					if (bytes_received + receiver.length > chart_size)
+					{
+						reply(fd, CHART_CAN);
+						return 1;
+					}
+					for (uint8_t i = 0; i < receiver.length; i++)
+					{
+						eeprom[DATA_ADDRESS + bytes_received++] =
+								receiver.payload[i];
+					}
+				}
+				reply(fd, CHART_ACK);
+				break;
+			case CHART_RX_REPEAT:
+				reply(fd, CHART_ACK);
+				break;
+			case CHART_RX_BAD:
+				reply(fd, CHART_NAK);
+				break;
+			case CHART_RX_END:
+				if (receiver.sequence == 0 || bytes_received != chart_size)
+				{
+					reply(fd, CHART_CAN);
+					return 1;
+				}
+				reply(fd, CHART_ACK);
+				stored = 1;
+				break;
+		}
+	}
+}
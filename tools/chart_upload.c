@@ -0,0 +1,266 @@
+/*
+ * chart_upload.c
+ *
+ * Upload a chart to the board over a serial port (see chart_protocol.h
+ * and chart_store.h). The chart file is text: one number (0 to 255, in
+ * decimal or hex) per row of the chart, separated by spaces, commas or
+ * new lines - as in the chart arrays in game.c, but with every empty row
+ * written out. Comments starting with // or # run to the end of the line.
+ * The chart is run-length encoded before it is sent.
+ *
+ * The board is first sent 'u', to start an upload from its start screen.
+ *
+ * Build with:
+ *   gcc -std=gnu99 -I.. -o chart_upload chart_upload.c ../chart_protocol.c
+ * and see chart_board_stub.c for testing without a board.
+ *
+ * This file is not part of the AVR build.
+ */
+
+#include <ctype.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include "chart_protocol.h"
+
+#define MAX_CHART_BYTES	65536
+#define MAX_ATTEMPTS	10
+
+static int reply_timeout = 1000;	// ms
+
+static void usage(const char* program)
+{
+	fprintf(stderr, "Usage: %s [-b baud] [-t timeout] device chart-file\n"
+			"  -b baud     serial port speed (default 19200)\n"
+			"  -t timeout  ms to wait for each reply (default 1000)\n",
+			program);
+	exit(2);
+}
+
+static speed_t baud_to_speed(long baud)
+{
+	switch (baud)
+	{
+		case 9600:
+			return B9600;
+		case 19200:
+			return B19200;
+		case 38400:
+			return B38400;
+		case 57600:
+			return B57600;
+		case 115200:
+			return B115200;
+		default:
+			fprintf(stderr, "Unsupported baud rate %ld\n", baud);
+			exit(2);
+	}
+}
+
+static int open_port(const char* device, speed_t speed)
+{
+	int fd = open(device, O_RDWR | O_NOCTTY);
+	if (fd < 0)
+	{
+		perror(device);
+		exit(1);
+	}
+	struct termios settings;
+	if (tcgetattr(fd, &settings) == 0)
+	{
+		cfmakeraw(&settings);
+		cfsetispeed(&settings, speed);
+		cfsetospeed(&settings, speed);
+		settings.c_cc[VMIN] = 0;
+		settings.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &settings);
+	}
+	return fd;
+}
+
+// Read the chart file, returning the number of rows. The rows are run
+// length encoded into data[], and *size set to the number of bytes.
+static long read_chart(const char* filename, uint8_t* data, long* size)
+{
+	FILE* in = fopen(filename, "r");
+	if (!in)
+	{
+		perror(filename);
+		exit(1);
+	}
+	long rows = 0;
+	long empty_rows = 0;
+	*size = 0;
+	char line[256];
+	while (fgets(line, sizeof(line), in))
+	{
+		char* p = line;
+		while (*p && *p != '#' && !(p[0] == '/' && p[1] == '/'))
+		{
+			if (isspace((unsigned char)*p) || *p == ',' || *p == '{'
+					|| *p == '}' || *p == ';')
+			{
+				p++;
+				continue;
+			}
+			char* end;
+			long value = strtol(p, &end, 0);
+			if (end == p || value < 0 || value > 255)
+			{
+				fprintf(stderr, "%s: bad row value near \"%.10s\"\n",
+						filename, p);
+				exit(1);
+			}
+			p = end;
+			rows++;
+			if (value == 0)
+			{
+				empty_rows++;
+				continue;
+			}
+			if (*size + 2 * (empty_rows / 255 + 1) + 1 > MAX_CHART_BYTES)
+			{
+				fprintf(stderr, "%s: chart is too long\n", filename);
+				exit(1);
+			}
+			while (empty_rows)
+			{
+				long run = (empty_rows > 255) ? 255 : empty_rows;
+				data[(*size)++] = 0x00;
+				data[(*size)++] = run;
+				empty_rows -= run;
+			}
+			data[(*size)++] = value;
+		}
+	}
+	while (empty_rows)
+	{
+		long run = (empty_rows > 255) ? 255 : empty_rows;
+		data[(*size)++] = 0x00;
+		data[(*size)++] = run;
+		empty_rows -= run;
+	}
+	fclose(in);
+	return rows;
+}
+
+// Wait for ACK, NAK or CAN from the board (anything else, e.g. terminal
+// output, is ignored). Returns the reply, or -1 if there is none in time.
+static int wait_for_reply(int fd)
+{
+	struct pollfd waiting = {fd, POLLIN, 0};
+	while (poll(&waiting, 1, reply_timeout) > 0)
+	{
+		uint8_t byte;
+		if (read(fd, &byte, 1) != 1)
+		{
+			fprintf(stderr, "Lost the connection to the board\n");
+			exit(1);
+		}
+		if (byte == CHART_ACK || byte == CHART_NAK || byte == CHART_CAN)
+		{
+			return byte;
+		}
+	}
+	return -1;
+}
+
+// Send bytes to the board until it ACKs them. Exits if it can't.
+static void send_until_acked(int fd, const uint8_t* bytes, uint8_t count,
+		const char* what)
+{
+	for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++)
+	{
+		if (write(fd, bytes, count) != count)
+		{
+			perror("write");
+			exit(1);
+		}
+		int reply = wait_for_reply(fd);
+		if (reply == CHART_ACK)
+		{
+			return;
+		}
+		if (reply == CHART_CAN)
+		{
+			fprintf(stderr, "The board refused the chart (at %s)\n", what);
+			exit(1);
+		}
+		fprintf(stderr, "%s: %s, sending again\n", what,
+				(reply == CHART_NAK) ? "NAK" : "no reply");
+	}
+	fprintf(stderr, "Giving up on %s\n", what);
+	exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+	long baud = 19200;
+	int option;
+	
+	while ((option = getopt(argc, argv, "b:t:")) != -1)
+	{
+		switch (option)
+		{
+			case 'b':
+				baud = atol(optarg);
+				break;
+			case 't':
+				reply_timeout = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if (optind + 2 != argc)
+	{
+		usage(argv[0]);
+	}
+	
+	static uint8_t data[MAX_CHART_BYTES];
+	long size;
+	long rows = read_chart(argv[optind + 1], data, &size);
+	if (rows > UINT16_MAX)
+	{
+		fprintf(stderr, "Chart is too long (%ld rows)\n", rows);
+		return 1;
+	}
+	
+	int fd = open_port(argv[optind], baud_to_speed(baud));
+	
+	// Start the upload, and throw away what the board prints in reply
+	if (write(fd, "u", 1) != 1)
+	{
+		perror("write");
+		return 1;
+	}
+	usleep(200000);
+	tcflush(fd, TCIFLUSH);
+	
+	uint8_t frame[CHART_MAX_FRAME];
+	uint8_t header[CHART_HEADER_LENGTH] = {rows & 0xFF, rows >> 8,
+			size & 0xFF, size >> 8};
+	uint8_t sequence = 0;
+	send_until_acked(fd, frame, chart_build_frame(frame, sequence++, header,
+			CHART_HEADER_LENGTH), "header");
+	
+	char what[32];
+	for (long sent = 0; sent < size; sent += CHART_MAX_PAYLOAD)
+	{
+		uint8_t length = (size - sent > CHART_MAX_PAYLOAD)
+				? CHART_MAX_PAYLOAD : size - sent;
+		snprintf(what, sizeof(what), "byte %ld", sent);
+		send_until_acked(fd, frame, chart_build_frame(frame, sequence++,
+				&data[sent], length), what);
+	}
+	
+	send_until_acked(fd, frame, chart_build_frame(frame, sequence, NULL, 0),
+			"end of chart");
+	printf("Uploaded %ld rows (%ld bytes)\n", rows, size);
+	close(fd);
+	return 0;
+}
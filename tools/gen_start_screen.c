@@ -0,0 +1,102 @@
+/*
+ * gen_start_screen.c
+ *
+ * Generate the start screen animation tables in display.c. The animation
+ * is defined by the expression below (from the original
+ * update_start_screen()); this program works out which pixels change
+ * from one frame to the next and prints them as C initialisers for
+ * start_screen_changes[] and start_screen_sections[].
+ *
+ * Build and run with:
+ *   gcc -std=gnu99 -o gen_start_screen gen_start_screen.c && ./gen_start_screen
+ *
+ * This file is not part of the AVR build.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../pixel_colour.h"
+
+#define NUM_FRAMES 32
+#define FIRST_COL 11
+#define LAST_COL 15
+#define FIRST_ROW 4
+#define LAST_ROW 7
+
+// Colour of the given pixel in the given frame of the animation
+static PixelColour animation_pixel(uint8_t frame_number, uint8_t col, uint8_t row)
+{
+	PixelColour colour = col == 14 ? COLOUR_YELLOW : COLOUR_BLACK;
+	if (((32+col-frame_number) & ((1<<(row-2))-1)) == (1<<(row-3))-1)
+	{
+		colour = col < 14 ? COLOUR_RED : COLOUR_GREEN;
+	}
+	return colour;
+}
+
+static const char* colour_name(PixelColour colour)
+{
+	switch (colour)
+	{
+		case COLOUR_RED:
+			return "COLOUR_RED";
+		case COLOUR_GREEN:
+			return "COLOUR_GREEN";
+		case COLOUR_YELLOW:
+			return "COLOUR_YELLOW";
+		default:
+			return "COLOUR_BLACK";
+	}
+}
+
+// Print the pixels whose colour in frame_number differs from their colour
+// in previous_frame (or from black if previous_frame is negative).
+// Returns the number of pixels printed.
+static int print_section(int previous_frame, uint8_t frame_number)
+{
+	int count = 0;
+	for (uint8_t col = FIRST_COL; col <= LAST_COL; col++)
+	{
+		for (uint8_t row = FIRST_ROW; row <= LAST_ROW; row++)
+		{
+			PixelColour colour = animation_pixel(frame_number, col, row);
+			PixelColour previous = previous_frame < 0 ? COLOUR_BLACK
+					: animation_pixel(previous_frame, col, row);
+			if (colour == previous)
+			{
+				continue;
+			}
+			printf("%s0x%02X, %s,", count % 4 ? " " : "\n\t", (row << 4) | col,
+					colour_name(colour));
+			count++;
+		}
+	}
+	return count;
+}
+
+int main(void)
+{
+	int sections[NUM_FRAMES + 2];
+	
+	printf("static const uint8_t start_screen_changes[] PROGMEM = {");
+	printf("\n\t// key frame (frame 0)");
+	sections[0] = 0;
+	sections[1] = print_section(-1, 0);
+	for (uint8_t frame_number = 0; frame_number < NUM_FRAMES; frame_number++)
+	{
+		printf("\n\t// frame %d", frame_number);
+		sections[frame_number + 2] = sections[frame_number + 1]
+				+ print_section((frame_number + NUM_FRAMES - 1) % NUM_FRAMES,
+				frame_number);
+	}
+	printf("\n\t};\n");
+	
+	printf("static const uint8_t start_screen_sections[] PROGMEM = {");
+	for (uint8_t i = 0; i < NUM_FRAMES + 2; i++)
+	{
+		printf("%s%d%s", i % 12 ? " " : "\n\t", sections[i],
+				i < NUM_FRAMES + 1 ? "," : "");
+	}
+	printf("};\n");
+	return 0;
+}
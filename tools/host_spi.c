@@ -0,0 +1,73 @@
+/*
+ * host_spi.c
+ *
+ * Stand-in for spi.c so that ledmatrix.c (and code which draws with it)
+ * can be compiled and run on a Linux box. Every byte sent is decoded by
+ * host_spi_emulator, and can also be written to a capture file for
+ * matrix_replay. host_spi_end_frame() records the current display as a
+ * frame and writes a frame mark (0xFF) to the capture.
+ *
+ * For example:
+ *   gcc -std=gnu99 -I.. -o test my_test.c ../ledmatrix.c ../palette.c \
+ *       host_spi.c matrix_emulator.c
+ *
+ * This file is not part of the AVR build.
+ */
+
+#include "host_spi.h"
+#include <stdint.h>
+#include <stdio.h>
+#include "../spi.h"
+
+MatrixEmulator host_spi_emulator;
+static FILE* capture;
+
+void host_spi_capture_to(FILE* file)
+{
+	capture = file;
+}
+
+void host_spi_end_frame(void)
+{
+	matrix_emu_end_frame(&host_spi_emulator);
+	if (capture)
+	{
+		fputc(HOST_SPI_FRAME_MARK, capture);
+	}
+}
+
+void spi_setup_master(uint8_t clockdivider)
+{
+	(void)clockdivider;
+	matrix_emu_init(&host_spi_emulator);
+}
+
+uint8_t spi_send_byte(uint8_t byte)
+{
+	spi_queue_byte(byte);
+	return 0;
+}
+
+void spi_queue_byte(uint8_t byte)
+{
+	(void)matrix_emu_feed(&host_spi_emulator, byte);
+	if (capture)
+	{
+		fputc(byte, capture);
+	}
+}
+
+uint8_t spi_queue_length(void)
+{
+	// Bytes are "sent" as soon as they are queued
+	return 0;
+}
+
+uint8_t spi_is_idle(void)
+{
+	return 1;
+}
+
+void spi_wait_until_idle(void)
+{
+}
@@ -0,0 +1,27 @@
+/*
+ * host_spi.h
+ *
+ * Stand-in for spi.c for running LED matrix code on a Linux box - see
+ * host_spi.c.
+ *
+ * This file is not part of the AVR build.
+ */
+
+#ifndef HOST_SPI_H_
+#define HOST_SPI_H_
+
+#include <stdio.h>
+#include "matrix_emulator.h"
+
+#define HOST_SPI_FRAME_MARK 0xFF
+
+// Emulator which decodes every byte sent to the matrix
+extern MatrixEmulator host_spi_emulator;
+
+// Also write every byte sent to the given file (NULL to stop)
+void host_spi_capture_to(FILE* file);
+
+// Record the current display as the end of a frame
+void host_spi_end_frame(void);
+
+#endif /* HOST_SPI_H_ */
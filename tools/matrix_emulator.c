@@ -0,0 +1,228 @@
+/*
+ * matrix_emulator.c
+ *
+ * Host (Linux) side emulator for the LED matrix - see matrix_emulator.h.
+ *
+ * This file is not part of the AVR build.
+ */
+
+#include "matrix_emulator.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// These must match the definitions in ledmatrix.c
+#define CMD_UPDATE_ALL		(0x00)
+#define CMD_UPDATE_PIXEL	(0x01)
+#define CMD_UPDATE_ROW		(0x02)
+#define CMD_UPDATE_COL		(0x03)
+#define CMD_SHIFT_DISPLAY	(0x04)
+#define CMD_CLEAR_SCREEN	(0x0F)
+
+// Directions for CMD_SHIFT_DISPLAY (several may be combined)
+#define SHIFT_RIGHT	(0x01)
+#define SHIFT_LEFT	(0x02)
+#define SHIFT_DOWN	(0x04)
+#define SHIFT_UP	(0x08)
+
+void matrix_emu_init(MatrixEmulator* emu)
+{
+	memset(emu, 0, sizeof(*emu));
+}
+
+void matrix_emu_free(MatrixEmulator* emu)
+{
+	free(emu->frames);
+	emu->frames = NULL;
+	emu->num_frames = 0;
+	emu->frames_allocated = 0;
+}
+
+static void shift_display(MatrixEmulator* emu, uint8_t directions)
+{
+	if (directions & SHIFT_RIGHT)
+	{
+		memmove(emu->pixels[1], emu->pixels[0],
+				(EMU_NUM_COLUMNS - 1) * EMU_NUM_ROWS);
+		memset(emu->pixels[0], COLOUR_BLACK, EMU_NUM_ROWS);
+	}
+	if (directions & SHIFT_LEFT)
+	{
+		memmove(emu->pixels[0], emu->pixels[1],
+				(EMU_NUM_COLUMNS - 1) * EMU_NUM_ROWS);
+		memset(emu->pixels[EMU_NUM_COLUMNS - 1], COLOUR_BLACK, EMU_NUM_ROWS);
+	}
+	for (uint8_t x = 0; x < EMU_NUM_COLUMNS; x++)
+	{
+		if (directions & SHIFT_UP)
+		{
+			memmove(&emu->pixels[x][1], &emu->pixels[x][0], EMU_NUM_ROWS - 1);
+			emu->pixels[x][0] = COLOUR_BLACK;
+		}
+		if (directions & SHIFT_DOWN)
+		{
+			memmove(&emu->pixels[x][0], &emu->pixels[x][1], EMU_NUM_ROWS - 1);
+			emu->pixels[x][EMU_NUM_ROWS - 1] = COLOUR_BLACK;
+		}
+	}
+}
+
+// Carry out a command once all its arguments have arrived
+static void execute_command(MatrixEmulator* emu)
+{
+	uint8_t* args = emu->args;
+	switch (emu->command)
+	{
+		case CMD_UPDATE_ALL:
+			for (uint8_t y = 0; y < EMU_NUM_ROWS; y++)
+			{
+				for (uint8_t x = 0; x < EMU_NUM_COLUMNS; x++)
+				{
+					emu->pixels[x][y] = args[y * EMU_NUM_COLUMNS + x];
+				}
+			}
+			break;
+		case CMD_UPDATE_PIXEL:
+			emu->pixels[args[0] & 0x0F][(args[0] >> 4) & 0x07] = args[1];
+			break;
+		case CMD_UPDATE_ROW:
+			for (uint8_t x = 0; x < EMU_NUM_COLUMNS; x++)
+			{
+				emu->pixels[x][args[0] & 0x07] = args[1 + x];
+			}
+			break;
+		case CMD_UPDATE_COL:
+			for (uint8_t y = 0; y < EMU_NUM_ROWS; y++)
+			{
+				emu->pixels[args[0] & 0x0F][y] = args[1 + y];
+			}
+			break;
+		case CMD_SHIFT_DISPLAY:
+			shift_display(emu, args[0]);
+			break;
+		case CMD_CLEAR_SCREEN:
+			memset(emu->pixels, COLOUR_BLACK, sizeof(emu->pixels));
+			break;
+	}
+	emu->total_commands++;
+	emu->frame_commands++;
+}
+
+int matrix_emu_feed(MatrixEmulator* emu, uint8_t byte)
+{
+	emu->total_bytes++;
+	emu->frame_bytes++;
+	
+	if (!emu->in_command)
+	{
+		emu->command = byte;
+		emu->num_args = 0;
+		switch (byte)
+		{
+			case CMD_UPDATE_ALL:
+				emu->args_needed = EMU_NUM_COLUMNS * EMU_NUM_ROWS;
+				break;
+			case CMD_UPDATE_PIXEL:
+				emu->args_needed = 2;
+				break;
+			case CMD_UPDATE_ROW:
+				emu->args_needed = 1 + EMU_NUM_COLUMNS;
+				break;
+			case CMD_UPDATE_COL:
+				emu->args_needed = 1 + EMU_NUM_ROWS;
+				break;
+			case CMD_SHIFT_DISPLAY:
+				emu->args_needed = 1;
+				break;
+			case CMD_CLEAR_SCREEN:
+				emu->args_needed = 0;
+				break;
+			default:
+				// Not a command the matrix knows - it is ignored
+				emu->bad_commands++;
+				return 0;
+		}
+		emu->in_command = 1;
+	}
+	else
+	{
+		emu->args[emu->num_args++] = byte;
+	}
+	
+	if (emu->num_args < emu->args_needed)
+	{
+		return 0;
+	}
+	emu->in_command = 0;
+	execute_command(emu);
+	return 1;
+}
+
+void matrix_emu_end_frame(MatrixEmulator* emu)
+{
+	if (emu->num_frames == emu->frames_allocated)
+	{
+		uint32_t size = emu->frames_allocated ? 2 * emu->frames_allocated : 64;
+		EmuFrame* frames = realloc(emu->frames, size * sizeof(EmuFrame));
+		if (!frames)
+		{
+			fprintf(stderr, "matrix_emu: out of memory\n");
+			exit(1);
+		}
+		emu->frames = frames;
+		emu->frames_allocated = size;
+	}
+	EmuFrame* frame = &emu->frames[emu->num_frames++];
+	memcpy(frame->pixels, emu->pixels, sizeof(frame->pixels));
+	frame->bytes = emu->frame_bytes;
+	frame->commands = emu->frame_commands;
+	emu->frame_bytes = 0;
+	emu->frame_commands = 0;
+}
+
+// Convert a 4 bit colour intensity to 8 bits
+static uint8_t intensity(uint8_t nibble)
+{
+	return (nibble & 0x0F) * 17;
+}
+
+void matrix_emu_print_ansi(FILE* out, EmuFrameBuffer pixels)
+{
+	// Row 7 is the top of the display
+	for (int8_t y = EMU_NUM_ROWS - 1; y >= 0; y--)
+	{
+		for (uint8_t x = 0; x < EMU_NUM_COLUMNS; x++)
+		{
+			PixelColour pixel = pixels[x][y];
+			fprintf(out, "\x1b[48;2;%d;%d;0m  ", intensity(pixel),
+					intensity(pixel >> 4));
+		}
+		fprintf(out, "\x1b[0m\n");
+	}
+}
+
+void matrix_emu_write_ppm(FILE* out, EmuFrameBuffer pixels, uint8_t scale)
+{
+	if (scale == 0)
+	{
+		scale = 1;
+	}
+	fprintf(out, "P6\n%d %d\n255\n", EMU_NUM_COLUMNS * scale,
+			EMU_NUM_ROWS * scale);
+	for (int8_t y = EMU_NUM_ROWS - 1; y >= 0; y--)
+	{
+		for (uint8_t i = 0; i < scale; i++)
+		{
+			for (uint8_t x = 0; x < EMU_NUM_COLUMNS; x++)
+			{
+				uint8_t rgb[3] = {intensity(pixels[x][y]),
+						intensity(pixels[x][y] >> 4), 0};
+				for (uint8_t j = 0; j < scale; j++)
+				{
+					fwrite(rgb, 1, sizeof(rgb), out);
+				}
+			}
+		}
+	}
+}
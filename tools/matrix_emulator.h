@@ -0,0 +1,81 @@
+/*
+ * matrix_emulator.h
+ *
+ * Host (Linux) side emulator for the LED matrix. Decodes the stream of
+ * bytes sent to the matrix by spi_send_byte()/spi_queue_byte() (see the
+ * CMD_* definitions in ledmatrix.c) and rebuilds the 16x8 display after
+ * every command. Snapshots of the display can be recorded as frames,
+ * along with the number of bytes each frame took to send, and frames can
+ * be printed as ANSI coloured text or written as PPM images.
+ *
+ * This file is not part of the AVR build.
+ */
+
+#ifndef MATRIX_EMULATOR_H_
+#define MATRIX_EMULATOR_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../pixel_colour.h"
+
+#define EMU_NUM_COLUMNS 16
+#define EMU_NUM_ROWS 8
+
+// Display contents, indexed [x][y] as for MatrixData in ledmatrix.h
+typedef PixelColour EmuFrameBuffer[EMU_NUM_COLUMNS][EMU_NUM_ROWS];
+
+// A recorded frame - the display contents and what it cost to send
+typedef struct
+{
+	EmuFrameBuffer pixels;
+	uint32_t bytes;
+	uint32_t commands;
+} EmuFrame;
+
+typedef struct
+{
+	// The display as it would be shown by the matrix
+	EmuFrameBuffer pixels;
+	
+	// Command being decoded - the command byte, the arguments received
+	// so far and the number of argument bytes it takes
+	uint8_t command;
+	uint8_t args[1 + EMU_NUM_COLUMNS * EMU_NUM_ROWS];
+	uint8_t num_args;
+	uint8_t args_needed;
+	uint8_t in_command;
+	
+	// Totals for the whole stream
+	uint32_t total_bytes;
+	uint32_t total_commands;
+	uint32_t bad_commands;
+	
+	// Bytes and commands since the last recorded frame
+	uint32_t frame_bytes;
+	uint32_t frame_commands;
+	
+	// Recorded frames
+	EmuFrame* frames;
+	uint32_t num_frames;
+	uint32_t frames_allocated;
+} MatrixEmulator;
+
+void matrix_emu_init(MatrixEmulator* emu);
+void matrix_emu_free(MatrixEmulator* emu);
+
+// Decode one byte of the stream. Returns 1 if the byte completed a
+// command (so emu->pixels has been updated), 0 otherwise.
+int matrix_emu_feed(MatrixEmulator* emu, uint8_t byte);
+
+// Record a snapshot of the display as the end of a frame. The frame's
+// byte and command counts are those since the previous frame.
+void matrix_emu_end_frame(MatrixEmulator* emu);
+
+// Print the display as ANSI coloured blocks (top row first)
+void matrix_emu_print_ansi(FILE* out, EmuFrameBuffer pixels);
+
+// Write the display as a binary PPM (P6) image, with each pixel drawn
+// as a scale x scale square
+void matrix_emu_write_ppm(FILE* out, EmuFrameBuffer pixels, uint8_t scale);
+
+#endif /* MATRIX_EMULATOR_H_ */
@@ -0,0 +1,145 @@
+/*
+ * matrix_replay.c
+ *
+ * Replay a capture of the bytes sent to the LED matrix on a Linux box.
+ * The capture is read from a file (or standard input) and decoded with
+ * the matrix emulator. For each frame the number of bytes and commands
+ * it took is printed, along with the frame as ANSI coloured text (-a)
+ * and/or a PPM image (-p).
+ *
+ * By default every command ends a frame. With -m, frames are instead
+ * ended by a frame mark byte (0xFF) inserted in the capture between
+ * commands - e.g. by a host test written with host_spi.c. 0xFF can also
+ * be a colour byte (COLOUR_YELLOW), so it is only taken as a mark when it
+ * arrives between commands.
+ *
+ * Build with:
+ *   gcc -std=gnu99 -o matrix_replay matrix_replay.c matrix_emulator.c
+ *
+ * This file is not part of the AVR build.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "matrix_emulator.h"
+
+#define FRAME_MARK 0xFF
+
+static void usage(const char* program)
+{
+	fprintf(stderr, "Usage: %s [-a] [-m] [-p prefix] [-s scale] [capture-file]\n"
+			"  -a         print each frame as ANSI coloured text\n"
+			"  -m         frames are ended by 0xFF mark bytes, not by each command\n"
+			"  -p prefix  write each frame to prefixNNNN.ppm\n"
+			"  -s scale   size of each LED in the PPM images (default 8)\n",
+			program);
+	exit(2);
+}
+
+int main(int argc, char* argv[])
+{
+	int print_ansi = 0;
+	int use_marks = 0;
+	const char* ppm_prefix = NULL;
+	int scale = 8;
+	int option;
+	
+	while ((option = getopt(argc, argv, "amp:s:")) != -1)
+	{
+		switch (option)
+		{
+			case 'a':
+				print_ansi = 1;
+				break;
+			case 'm':
+				use_marks = 1;
+				break;
+			case 'p':
+				ppm_prefix = optarg;
+				break;
+			case 's':
+				scale = atoi(optarg);
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	
+	FILE* in = stdin;
+	if (optind < argc)
+	{
+		in = fopen(argv[optind], "rb");
+		if (!in)
+		{
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	
+	MatrixEmulator emu;
+	matrix_emu_init(&emu);
+	int c;
+	while ((c = fgetc(in)) != EOF)
+	{
+		if (use_marks)
+		{
+			if (c == FRAME_MARK && !emu.in_command)
+			{
+				matrix_emu_end_frame(&emu);
+			}
+			else
+			{
+				(void)matrix_emu_feed(&emu, c);
+			}
+		}
+		else if (matrix_emu_feed(&emu, c))
+		{
+			matrix_emu_end_frame(&emu);
+		}
+	}
+	if (emu.frame_bytes)
+	{
+		// Whatever follows the last mark is a frame too
+		matrix_emu_end_frame(&emu);
+	}
+	
+	for (uint32_t i = 0; i < emu.num_frames; i++)
+	{
+		EmuFrame* frame = &emu.frames[i];
+		printf("frame %u: %u bytes, %u commands\n", i, frame->bytes,
+				frame->commands);
+		if (print_ansi)
+		{
+			matrix_emu_print_ansi(stdout, frame->pixels);
+		}
+		if (ppm_prefix)
+		{
+			char filename[256];
+			snprintf(filename, sizeof(filename), "%s%04u.ppm", ppm_prefix, i);
+			FILE* out = fopen(filename, "wb");
+			if (!out)
+			{
+				perror(filename);
+				return 1;
+			}
+			matrix_emu_write_ppm(out, frame->pixels, scale);
+			fclose(out);
+		}
+	}
+	printf("%u frames, %u bytes, %u commands", emu.num_frames,
+			emu.total_bytes, emu.total_commands);
+	if (emu.bad_commands)
+	{
+		printf(", %u unknown command bytes", emu.bad_commands);
+	}
+	if (emu.num_frames)
+	{
+		printf(", %.1f bytes per frame", (double)emu.total_bytes / emu.num_frames);
+	}
+	printf("\n");
+	
+	matrix_emu_free(&emu);
+	return 0;
+}
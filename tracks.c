@@ -0,0 +1,158 @@
+/*
+ * tracks.c
+ *
+ * The catalog of tracks - see tracks.h.
+ *
+ * To add a built-in track, add its data and name below and an entry for
+ * it in the catalog (and increase NUM_TRACKS).
+ */
+
+#include "tracks.h"
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "chart_store.h"
+
+// The built-in tracks. The number of rows in each track (including the
+// empty ones) is given by its _LENGTH.
+
+#define CUSTOM_TRACK_LENGTH 129
+static const uint8_t custom_track[] PROGMEM = {0x00, 1,
+	0x00, 2, 0x08, 0x08, 0x08, 0x80, 0x04, 0x02,
+	0x04, 0x40, 0x08, 0x80, 0x00, 2, 0x04, 0x02,
+	0x04, 0x40, 0x08, 0x04, 0x40, 0x02, 0x20, 0x01,
+	0x10, 0x10, 0x10, 0x10, 0x00, 2, 0x02, 0x20,
+	0x04, 0x40, 0x08, 0x80, 0x04, 0x40, 0x02, 0x20,
+	0x04, 0x40, 0x08, 0x04, 0x40, 0x40, 0x02, 0x20,
+	0x04, 0x40, 0x08, 0x04, 0x40, 0x02, 0x20, 0x01,
+	0x10, 0x10, 0x10, 0x10, 0x00, 4,
+	0x00, 2, 0x08, 0x08, 0x08, 0x80, 0x04, 0x02,
+	0x04, 0x40, 0x02, 0x08, 0x80, 0x00, 1, 0x02, 0x01,
+	0x04, 0x40, 0x08, 0x80, 0x04, 0x02, 0x20, 0x01,
+	0x10, 0x10, 0x12, 0x20, 0x00, 2, 0x02, 0x20,
+	0x04, 0x40, 0x08, 0x04, 0x40, 0x40, 0x02, 0x20,
+	0x04, 0x40, 0x08, 0x04, 0x40, 0x40, 0x02, 0x20,
+	0x04, 0x40, 0x08, 0x04, 0x40, 0x40, 0x02, 0x20,
+	0x01, 0x10, 0x10, 0x10, 0x00, 4};
+	
+#define TWINKLE_TWINKLE_LITTLE_STAR_LENGTH 129
+static const uint8_t twinkle_twinkle_little_star[] PROGMEM = {0x00, 3,// (pause)
+	0x02, 0x02, 0x04, 0x04, 0x08, 0x08, 0x04, 0x00, 1, // Twinkle, twinkle,
+	0x04, 0x04, 0x02, 0x02, 0x01, 0x01, 0x08, 0x00, 1, // little star,
+	0x08, 0x08, 0x04, 0x04, 0x02, 0x02, 0x01, 0x00, 1, // How I wonder
+	0x02, 0x02, 0x04, 0x04, 0x08, 0x08, 0x04, 0x00, 1, // what you are!
+	0x04, 0x04, 0x02, 0x02, 0x01, 0x01, 0x08, 0x00, 1, // Twinkle, twinkle,
+	0x04, 0x04, 0x02, 0x02, 0x01, 0x01, 0x08, 0x00, 1, // little star,
+	0x08, 0x08, 0x04, 0x04, 0x02, 0x02, 0x01, 0x00, 1, // How I wonder
+	0x02, 0x02, 0x04, 0x04, 0x08, 0x08, 0x04, 0x00, 1, // what you are!
+	0x00, 2, 0x08, 0x08, 0x04, 0x04, 0x02, 0x00, 1, // Up above the
+	0x02, 0x02, 0x01, 0x01, 0x08, 0x08, 0x04, 0x00, 1, // world so high,
+	0x01, 0x01, 0x02, 0x02, 0x04, 0x04, 0x02, 0x00, 1, // like a diamond
+	0x00, 2, 0x08, 0x08, 0x04, 0x04, 0x02, 0x00, 1, // Up above the
+	0x02, 0x02, 0x01, 0x01, 0x08, 0x08, 0x04, 0x00, 1, // world so high,
+	0x01, 0x01, 0x02, 0x02, 0x04, 0x04, 0x02, 0x00, 1, // like a diamond
+	0x02, 0x02, 0x04, 0x04, 0x08, 0x08, 0x04, 0x00, 1, // Twinkle, twinkle,
+	0x00, 6 // little star,
+	};
+
+#define JINGLE_BELLS_LENGTH 129
+static const uint8_t jingle_bells[] PROGMEM = {0x00, 2, // (pause)
+	0x00, 1, // (pause)
+	0x08, 0x08, 0x08, 0x00, 1, // G G G (pause)
+	0x08, 0x08, 0x08, 0x00, 1, // G G G (pause)
+	0x08, 0x04, 0x02, 0x02, 0x02, 0x08, 0x04, // G F E E E G F (pause) D
+	0x01, 0x01, 0x01, 0x02, 0x02, 0x08, 0x04, 0x00, 1, // D D D E E G F (pause) D
+	0x08, 0x00, 1, // G (pause)
+	0x08, 0x04, 0x02, 0x02, 0x02, 0x00, 1, // G F E E E (pause)
+	0x08, 0x08, 0x08, 0x00, 1, // G G G (pause)
+	0x08, 0x08, 0x08, 0x04, // G G G F
+	0x01, 0x02, 0x02, 0x02, 0x08, 0x04, // D E E E G F
+	0x01, 0x01, 0x02, 0x02, 0x02, 0x04, 0x04, 0x02, // D D E E E F F G
+	0x02, 0x02, 0x02, 0x02, 0x01, 0x01, 0x02, 0x02, // E E E E D D E E
+	0x08, 0x08, 0x02, 0x02, 0x02, 0x02, 0x02, 0x01, // G G A A A A B D
+	0x02, 0x02, 0x02, 0x00, 1, // E E E (pause)
+
+	0x02, 0x02, 0x02, 0x00, 1, // F F F (pause)
+	0x02, 0x02, 0x02, 0x00, 1, // E E E (pause)
+	0x08, 0x04, 0x02, 0x02, 0x02, 0x08, 0x04, // G F E E E G F (pause) D
+	0x01, 0x01, 0x01, 0x02, 0x02, 0x08, 0x04, 0x00, 1, // D D D E E G F (pause) D
+	0x08, 0x00, 1, // G (pause)
+	0x08, 0x04, 0x02, 0x02, 0x02, 0x00, 1, // G F E E E (pause)
+	0x08, 0x08, 0x08, 0x00, 1, // G G G (pause)
+	0x08, 0x08, 0x08, 0x04, // G G G F
+	0x01, 0x02, 0x02, 0x02, 0x08, 0x04, // D E E E G F
+
+	0x00, 8, // (pause)
+	};
+
+static const char custom_track_name[] PROGMEM = "Through the Fire and Flames";
+static const char twinkle_twinkle_little_star_name[] PROGMEM =
+		"Twinkle Twinkle Little Star";
+static const char jingle_bells_name[] PROGMEM = "Jingle Bells";
+static const char uploaded_track_name[] PROGMEM = "Uploaded Chart";
+
+// The catalog. The uploaded track's data, size and length are looked up
+// in the chart store when it is chosen.
+static const Track catalog[NUM_TRACKS] PROGMEM = {
+	{custom_track_name, custom_track, sizeof(custom_track),
+			CUSTOM_TRACK_LENGTH, 60, TRACK_HARD, TRACK_IN_FLASH},
+	{twinkle_twinkle_little_star_name, twinkle_twinkle_little_star,
+			sizeof(twinkle_twinkle_little_star),
+			TWINKLE_TWINKLE_LITTLE_STAR_LENGTH, 60, TRACK_EASY, TRACK_IN_FLASH},
+	{jingle_bells_name, jingle_bells, sizeof(jingle_bells),
+			JINGLE_BELLS_LENGTH, 60, TRACK_MEDIUM, TRACK_IN_FLASH},
+	{uploaded_track_name, 0, 0, 0, 60, TRACK_MEDIUM, TRACK_IN_EEPROM}
+	};
+
+static const char easy_name[] PROGMEM = "Easy";
+static const char medium_name[] PROGMEM = "Medium";
+static const char hard_name[] PROGMEM = "Hard";
+static const char* const difficulty_names[] PROGMEM = {
+	easy_name, medium_name, hard_name};
+
+void track_get(uint8_t number, Track* track)
+{
+	if (number >= NUM_TRACKS)
+	{
+		number = 0;
+	}
+	memcpy_P(track, &catalog[number], sizeof(Track));
+	if (track->source == TRACK_IN_EEPROM)
+	{
+		track->data = chart_store_data();
+		track->size = chart_store_valid() ? chart_store_size() : 0;
+		track->length = chart_store_valid() ? chart_store_length() : 0;
+	}
+}
+
+uint8_t track_available(uint8_t number)
+{
+	if (number >= NUM_TRACKS)
+	{
+		return 0;
+	}
+	if (pgm_read_byte(&catalog[number].source) == TRACK_IN_EEPROM)
+	{
+		return chart_store_valid();
+	}
+	return 1;
+}
+
+uint8_t track_next(uint8_t number)
+{
+	do
+	{
+		number = (number + 1) % NUM_TRACKS;
+	} while (!track_available(number));
+	return number;
+}
+
+const char* track_name(uint8_t number)
+{
+	return (const char*)pgm_read_word(&catalog[number].name);
+}
+
+const char* track_difficulty_name(uint8_t number)
+{
+	uint8_t difficulty = pgm_read_byte(&catalog[number].difficulty);
+	return (const char*)pgm_read_word(&difficulty_names[difficulty]);
+}
@@ -0,0 +1,56 @@
+/*
+ * tracks.h
+ *
+ * The catalog of tracks which can be played: the built-in tracks (kept in
+ * flash) and a track uploaded over the serial port (kept in EEPROM - see
+ * chart_store.h). Tracks are numbered from 0 to NUM_TRACKS-1.
+ *
+ * A track's data is its rows of notes, one byte per row (bit n set for a
+ * note in lane n), except that a 0x00 byte is followed by a count of
+ * empty rows - so long pauses take only two bytes.
+ */
+
+#ifndef TRACKS_H_
+#define TRACKS_H_
+
+#include <stdint.h>
+
+#define NUM_TRACKS 4
+
+// Where a track's data is kept
+#define TRACK_IN_FLASH	0
+#define TRACK_IN_EEPROM	1
+
+// Difficulty ratings
+#define TRACK_EASY		0
+#define TRACK_MEDIUM	1
+#define TRACK_HARD		2
+
+typedef struct
+{
+	const char* name;		// in flash
+	const uint8_t* data;	// address in flash or EEPROM (see source)
+	uint16_t size;			// number of bytes of data
+	uint16_t length;		// number of rows, including empty ones
+	uint16_t tempo;			// rows per minute at normal speed
+	uint8_t difficulty;		// TRACK_EASY, TRACK_MEDIUM or TRACK_HARD
+	uint8_t source;			// TRACK_IN_FLASH or TRACK_IN_EEPROM
+} Track;
+
+// Copy the catalog entry for the given track into *track
+void track_get(uint8_t number, Track* track);
+
+// Return non-zero if the given track can be played (an uploaded track
+// only can be once one has been uploaded)
+uint8_t track_available(uint8_t number);
+
+// Return the number of the next track which can be played after the
+// given one, wrapping around to track 0
+uint8_t track_next(uint8_t number);
+
+// Return the given track's name (a string in flash, e.g. for printf_P's
+// %S) and the name of its difficulty rating (likewise)
+const char* track_name(uint8_t number);
+const char* track_difficulty_name(uint8_t number);
+
+#endif /* TRACKS_H_ */
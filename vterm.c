@@ -0,0 +1,108 @@
+/*
+ * vterm.c
+ *
+ * A retained-mode view of part of the serial terminal - see vterm.h.
+ */
+
+#include "vterm.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "terminalio.h"
+#include "serialio.h"
+
+// What each row should show and what it does show (strings in program
+// memory, NULL if blank). A row only needs sending if the two differ.
+static const char* wanted[VTERM_ROWS];
+static const char* shown[VTERM_ROWS];
+
+// The most characters a cursor movement and clearing the rest of a row
+// can take
+#define MOVE_BYTES 8
+#define CLEAR_BYTES 3
+
+void vterm_reset(void)
+{
+	for (uint8_t i = 0; i < VTERM_ROWS; i++)
+	{
+		wanted[i] = NULL;
+		shown[i] = NULL;
+	}
+}
+
+void vterm_set_line(uint8_t row, const char* text)
+{
+	if (row >= VTERM_FIRST_ROW && row < VTERM_FIRST_ROW + VTERM_ROWS)
+	{
+		wanted[row - VTERM_FIRST_ROW] = text;
+	}
+}
+
+// Read character i of a row's line (a NUL past its end, or if it is blank)
+static char line_char(const char* text, uint8_t i)
+{
+	return text ? pgm_read_byte(&text[i]) : '\0';
+}
+
+void vterm_update(void)
+{
+	// Where the cursor is, if we know (we don't until we've moved it -
+	// something else may have printed since the last update)
+	int cursor_x = 0;
+	int cursor_y = 0;
+	for (uint8_t i = 0; i < VTERM_ROWS; i++)
+	{
+		const char* text = wanted[i];
+		const char* old = shown[i];
+		if (text == old)
+		{
+			continue;
+		}
+		
+		// Skip the characters which are already showing
+		uint8_t first = 0;
+		while (line_char(text, first) != '\0'
+				&& line_char(text, first) == line_char(old, first))
+		{
+			first++;
+		}
+		
+		// This is cosmetic output (see serialio.h) - stop if there isn't
+		// room for the row, and send it in a later update
+		uint8_t length = text ? strlen_P(text) : 0;
+		if (!serial_reserve_output(SERIAL_COSMETIC,
+				MOVE_BYTES + (length - first) + CLEAR_BYTES))
+		{
+			break;
+		}
+		int x = VTERM_COLUMN + first;
+		int y = VTERM_FIRST_ROW + i;
+		if (cursor_y == 0)
+		{
+			move_terminal_cursor(x, y);
+		}
+		else
+		{
+			move_terminal_cursor_from(cursor_x, cursor_y, x, y);
+		}
+		
+		// Send the rest of the new line, and clear anything left of the
+		// old one after it
+		uint8_t j = first;
+		char c;
+		while ((c = line_char(text, j)) != '\0')
+		{
+			putchar(c);
+			j++;
+		}
+		if (old && strlen_P(old) > j)
+		{
+			clear_to_end_of_line();
+		}
+		shown[i] = text;
+		cursor_x = VTERM_COLUMN + j;
+		cursor_y = y;
+	}
+}
@@ -0,0 +1,35 @@
+/*
+ * vterm.h
+ *
+ * A retained-mode view of part of the serial terminal - the rows from
+ * VTERM_FIRST_ROW to VTERM_FIRST_ROW + VTERM_ROWS - 1, each of which
+ * holds one line of text (from program memory) starting at VTERM_COLUMN.
+ * The program says what each row should show with vterm_set_line() as
+ * often as it likes; nothing is sent then. vterm_update() sends only the
+ * differences between what the rows show and what they should show, as
+ * cosmetic output (see serialio.h) - only as much as the output buffer
+ * has room to spare for - so it can be called every time around the main
+ * loop without filling the serial output buffer.
+ */
+
+#ifndef VTERM_H_
+#define VTERM_H_
+
+#include <stdint.h>
+
+#define VTERM_FIRST_ROW		26
+#define VTERM_ROWS			9
+#define VTERM_COLUMN		10
+
+// Forget what the rows show - call when the terminal has been cleared.
+// The rows are taken to be blank, and to be meant to stay blank.
+void vterm_reset(void);
+
+// Say what the given terminal row should show: text is a string in
+// program memory, or NULL for a blank row.
+void vterm_set_line(uint8_t row, const char* text);
+
+// Send as many of the changes as there is room for.
+void vterm_update(void);
+
+#endif /* VTERM_H_ */